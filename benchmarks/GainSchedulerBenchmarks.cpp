@@ -0,0 +1,214 @@
+/** Convergence of the visual servoing loop with each GainScheduler
+ *
+ * The loop is simulated along the direction of the error: the task
+ * acceleration is a PD on the last measured error (30 Hz, delayed), the
+ * speed is bounded and a constant disturbance (friction, gravity, competing
+ * tasks) makes a soft task stall away from the target. Each benchmark
+ * reports the convergence time (same criteria as ApproachVisualServoing) and
+ * the overshoot, the measured time is the cost of the simulation.
+ *
+ * BM_Tracking moves the target at a constant speed and reports the tracking
+ * lag with and without the velocity feed-forward of ApproachVisualServoing.
+ */
+
+#include <mc_whycon_plugin/GainScheduler.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+using namespace whycon_plugin;
+
+struct Scenario
+{
+  double dt = 0.005;
+  /** Initial error [m] */
+  double error = 0.1;
+  /** Disturbance opposing the motion [m/s^2] */
+  double disturbance = 0;
+  double stiffness = 2;
+  double maxStiffness = 100;
+  double maxSpeed = 0.05;
+  /** Convergence thresholds */
+  double eval = 0.005;
+  double speed = 0.005;
+  /** Camera rate [Hz] and latency [s] */
+  double rate = 30;
+  double latency = 0.05;
+  /** Give up after this duration [s] */
+  double timeout = 60;
+  /** Speed of the target along the error [m/s], the loop then runs until the timeout */
+  double targetSpeed = 0;
+  /** Feed the target speed forward to the task (refVel) */
+  bool feedForward = false;
+};
+
+struct Result
+{
+  /** Time to convergence, timeout if the task did not converge [s] */
+  double convergence = 0;
+  /** Largest error past the target [m] */
+  double overshoot = 0;
+  /** Stiffness at convergence */
+  double stiffness = 0;
+  /** Mean error over the last second when the target moves [m] */
+  double lag = 0;
+};
+
+/** Simulate the loop, the stiffness is constant if scheduler is null */
+Result simulate(const Scenario & s, GainScheduler * scheduler)
+{
+  Result result;
+  if(scheduler)
+  {
+    scheduler->reset();
+  }
+  double e = s.error;
+  double v = 0;
+  // Measurement ring (capture time and error) to apply the latency
+  constexpr size_t N = 64;
+  double stamps[N];
+  double errors[N];
+  size_t head = 0;
+  size_t count = 0;
+  double measured = e;
+  double lastCapture = -1;
+  double lastMeasurement = 0;
+  size_t converged = 0;
+  double lag = 0;
+  size_t lagSamples = 0;
+  double t = 0;
+  for(; t < s.timeout; t += s.dt)
+  {
+    if(t - lastCapture >= 1 / s.rate)
+    {
+      stamps[(head + count) % N] = t;
+      errors[(head + count) % N] = e;
+      count = std::min(count + 1, N);
+      lastCapture = t;
+    }
+    while(count != 0 && stamps[head] + s.latency <= t)
+    {
+      measured = errors[head];
+      lastMeasurement = t;
+      head = (head + 1) % N;
+      count--;
+    }
+    GainSchedulerInput input;
+    input.error = std::abs(measured);
+    input.speed = std::abs(v);
+    input.speedThreshold = s.speed;
+    input.maxSpeed = s.maxSpeed;
+    input.age = t - lastMeasurement;
+    input.dt = s.dt;
+    const double k = scheduler ? scheduler->update(input) : s.stiffness;
+    // The task speed is the rate of the error due to the robot motion alone
+    const double refVel = s.feedForward ? s.targetSpeed : 0;
+    double a = -k * measured - 2 * std::sqrt(k) * (v - refVel);
+    // The disturbance opposes the motion (or the command when at rest)
+    const double direction = v != 0 ? v : a;
+    if(direction != 0)
+    {
+      a -= std::copysign(std::min(s.disturbance, std::abs(a) + std::abs(v) / s.dt), direction);
+    }
+    v = std::clamp(v + a * s.dt, -s.maxSpeed, s.maxSpeed);
+    e += (v - s.targetSpeed) * s.dt;
+    result.overshoot = std::max(result.overshoot, -e);
+    if(s.targetSpeed != 0)
+    {
+      if(t >= s.timeout - 1)
+      {
+        lag += std::abs(e);
+        lagSamples++;
+      }
+      continue;
+    }
+    if(std::abs(measured) < s.eval && std::abs(v) < s.speed)
+    {
+      if(++converged > 10)
+      {
+        break;
+      }
+    }
+    else
+    {
+      converged = 0;
+    }
+  }
+  result.convergence = t;
+  result.stiffness = scheduler ? scheduler->stiffness() : s.stiffness;
+  result.lag = lagSamples != 0 ? lag / static_cast<double>(lagSamples) : 0;
+  return result;
+}
+
+/** Arguments: scheduler type (0: heuristic, 1: adaptive), disturbance [mm/s^2],
+ * maximum speed [mm/s] and latency [ms]
+ *
+ * A fast loop with a long latency acts on a stale error and can overshoot.
+ */
+void BM_Convergence(benchmark::State & state)
+{
+  Scenario scenario;
+  scenario.disturbance = 1e-3 * static_cast<double>(state.range(1));
+  scenario.maxSpeed = 1e-3 * static_cast<double>(state.range(2));
+  scenario.latency = 1e-3 * static_cast<double>(state.range(3));
+  GainSchedulerConfig config;
+  config.type = state.range(0) == 0 ? GainSchedulerConfig::Type::Heuristic : GainSchedulerConfig::Type::Adaptive;
+  auto scheduler = makeGainScheduler(scenario.stiffness, scenario.maxStiffness, config);
+  Result result;
+  for(auto _ : state)
+  {
+    result = simulate(scenario, scheduler.get());
+    benchmark::DoNotOptimize(result);
+  }
+  state.counters["convergence_s"] = result.convergence;
+  state.counters["overshoot_mm"] = 1000 * result.overshoot;
+  state.counters["stiffness"] = result.stiffness;
+  state.SetLabel(config.type == GainSchedulerConfig::Type::Heuristic ? "heuristic" : "adaptive");
+}
+BENCHMARK(BM_Convergence)
+    ->Args({0, 0, 50, 50})
+    ->Args({1, 0, 50, 50})
+    ->Args({0, 100, 50, 50})
+    ->Args({1, 100, 50, 50})
+    ->Args({0, 300, 50, 50})
+    ->Args({1, 300, 50, 50})
+    ->Args({0, 0, 200, 300})
+    ->Args({1, 0, 200, 300})
+    ->Args({0, 100, 200, 300})
+    ->Args({1, 100, 200, 300})
+    ->Unit(benchmark::kMillisecond);
+
+/** Arguments: feed-forward (0: off, 1: on), target speed [mm/s]
+ *
+ * The stiffness is kept constant so that the lag only depends on the
+ * feed-forward: without it the PD settles 2 * v / sqrt(k) behind the
+ * target.
+ */
+void BM_Tracking(benchmark::State & state)
+{
+  Scenario scenario;
+  scenario.feedForward = state.range(0) != 0;
+  scenario.targetSpeed = 1e-3 * static_cast<double>(state.range(1));
+  scenario.timeout = 10;
+  Result result;
+  for(auto _ : state)
+  {
+    result = simulate(scenario, nullptr);
+    benchmark::DoNotOptimize(result);
+  }
+  state.counters["lag_mm"] = 1000 * result.lag;
+  state.SetLabel(scenario.feedForward ? "feed-forward" : "no feed-forward");
+}
+BENCHMARK(BM_Tracking)
+    ->Args({0, 10})
+    ->Args({1, 10})
+    ->Args({0, 30})
+    ->Args({1, 30})
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,120 @@
+/** Loopback latency of the measurement sources
+ *
+ * Each iteration writes one measurement and waits until the source delivers
+ * it to the subscriber, the reported time is this round-trip latency. The ROS
+ * benchmark is skipped when no ROS master is running.
+ */
+
+#include <mc_rtc/ros.h>
+#include <mc_whycon_plugin/RosSource.h>
+#include <mc_whycon_plugin/SharedMemorySource.h>
+
+#include <benchmark/benchmark.h>
+#include <whycon_lshape/WhyConLShapeMsg.h>
+
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+
+using namespace whycon_plugin;
+using clock_type = std::chrono::steady_clock;
+
+/** Minimal sink counting the published measurements */
+struct LoopbackSink : public MeasurementSink
+{
+  std::atomic<uint64_t> published{0};
+
+  double now() const override
+  {
+    return SharedMemoryRing::now();
+  }
+
+  size_t index(const std::string & name) const override
+  {
+    return name == "marker" ? 0 : npos;
+  }
+
+  void measurement(size_t, const sva::PTransformd &, double, double) override {}
+
+  void publish() override
+  {
+    published++;
+  }
+
+  void camera(double, const sva::PTransformd &) override {}
+
+  /** Wait until the number of published measurements exceeds count */
+  void wait(uint64_t count) const
+  {
+    while(published.load() <= count)
+    {
+    }
+  }
+};
+
+void BM_SharedMemoryLoopback(benchmark::State & state)
+{
+  auto ring = SharedMemoryRing::create("/whycon_benchmark");
+  LoopbackSink sink;
+  // Poll as fast as possible to measure the transport rather than the polling period
+  SharedMemorySource source("/whycon_benchmark", 0.0);
+  source.start(sink);
+  const auto pose = sva::PTransformd::Identity();
+  // Wait for the source to open the ring
+  ring->write("marker", SharedMemoryRing::now(), pose);
+  while(sink.published.load() == 0)
+  {
+    ring->write("marker", SharedMemoryRing::now(), pose);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  for(auto _ : state)
+  {
+    const auto count = sink.published.load();
+    const auto start = clock_type::now();
+    ring->write("marker", SharedMemoryRing::now(), pose);
+    sink.wait(count);
+    state.SetIterationTime(std::chrono::duration<double>(clock_type::now() - start).count());
+  }
+  source.stop();
+}
+BENCHMARK(BM_SharedMemoryLoopback)->UseManualTime();
+
+void BM_RosLoopback(benchmark::State & state)
+{
+  auto nh = mc_rtc::ROSBridge::get_node_handle();
+  if(!nh || !ros::master::check())
+  {
+    state.SkipWithError("No ROS master");
+    return;
+  }
+  const std::string topic = "/whycon_benchmark";
+  LoopbackSink sink;
+  RosSource<whycon_lshape::WhyConLShapeMsg> source(nh, topic, 1,
+                                                   [&sink](const whycon_lshape::WhyConLShapeMsg &)
+                                                   { sink.publish(); });
+  source.start(sink);
+  auto pub = nh->advertise<whycon_lshape::WhyConLShapeMsg>(topic, 1);
+  while(pub.getNumSubscribers() == 0)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  whycon_lshape::WhyConLShapeMsg msg;
+  msg.shapes.resize(1);
+  msg.shapes[0].name = "marker";
+  msg.shapes[0].pose.orientation.w = 1.0;
+  for(auto _ : state)
+  {
+    const auto count = sink.published.load();
+    const auto start = clock_type::now();
+    msg.header.stamp = ros::Time::now();
+    pub.publish(msg);
+    sink.wait(count);
+    state.SetIterationTime(std::chrono::duration<double>(clock_type::now() - start).count());
+  }
+  source.stop();
+}
+BENCHMARK(BM_RosLoopback)->UseManualTime();
+
+} // namespace
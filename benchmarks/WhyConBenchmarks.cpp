@@ -0,0 +1,354 @@
+/** Micro-benchmarks of the WhyCon plugin
+ *
+ * Every benchmark runs without a ROS master: the subscribers are created with
+ * whycon/source: none and fed with synthetic messages through process().
+ *
+ * The global operator new is replaced to count the heap allocations, the
+ * control loop benchmarks report them per iteration and fail if any happens.
+ */
+
+#include <mc_control/fsm/Controller.h>
+#include <mc_rbdyn/RobotLoader.h>
+#include <mc_tasks/PositionBasedVisServoTask.h>
+#include <mc_whycon_plugin/WhyConSubscriber.h>
+#include <mc_whycon_plugin/WhyConUpdater.h>
+
+#include "ApproachVisualServoing.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+
+namespace
+{
+
+/** Number of heap allocations since the start of the program */
+std::atomic<uint64_t> allocations{0};
+
+void * allocate(std::size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if(void * p = std::malloc(size == 0 ? 1 : size))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void * allocate(std::size_t size, std::align_val_t alignment)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  const auto align = static_cast<std::size_t>(alignment);
+  // aligned_alloc requires a multiple of the alignment
+  if(void * p = std::aligned_alloc(align, (size + align - 1) / align * align))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+} // namespace
+
+void * operator new(std::size_t size)
+{
+  return allocate(size);
+}
+
+void * operator new[](std::size_t size)
+{
+  return allocate(size);
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+  return allocate(size, alignment);
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return allocate(size, alignment);
+}
+
+void operator delete(void * p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void * p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void * p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void * p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void * p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+
+using namespace whycon_plugin;
+
+constexpr double dt = 0.005;
+
+mc_rbdyn::RobotModulePtr robotModule()
+{
+  static auto rm = mc_rbdyn::RobotLoader::get_robot_module("JVRC1");
+  return rm;
+}
+
+std::string markerName(size_t i)
+{
+  return "marker_" + std::to_string(i);
+}
+
+/** Configuration of a subscriber tracking n markers attached to frame */
+mc_rtc::Configuration subscriberConfig(size_t n, const std::string & frame = "R_WRIST_Y_S")
+{
+  mc_rtc::Configuration config;
+  auto whycon = config.add("whycon");
+  whycon.add("source", std::string("none"));
+  auto markers = whycon.add("markers");
+  for(size_t i = 0; i < n; ++i)
+  {
+    markers.add(markerName(i)).add("relative", frame);
+  }
+  return config;
+}
+
+/** Message containing n shapes, shape i is named after marker i */
+whycon_lshape::WhyConLShapeMsg makeMessage(size_t n)
+{
+  whycon_lshape::WhyConLShapeMsg msg;
+  msg.shapes.resize(n);
+  for(size_t i = 0; i < n; ++i)
+  {
+    auto & s = msg.shapes[i];
+    s.name = markerName(i);
+    s.pose.position.x = 0.01 * static_cast<double>(i);
+    s.pose.position.y = 0.0;
+    s.pose.position.z = 1.0;
+    s.pose.orientation.w = 1.0;
+    s.pose.orientation.x = 0.0;
+    s.pose.orientation.y = 0.0;
+    s.pose.orientation.z = 0.0;
+  }
+  return msg;
+}
+
+/** Count the heap allocations of a benchmark loop
+ *
+ * Reports the allocations per iteration and marks the benchmark as failed if
+ * the loop allocated.
+ */
+struct AllocationCheck
+{
+  AllocationCheck(benchmark::State & state) : state_(state), start_(allocations.load()) {}
+
+  ~AllocationCheck()
+  {
+    const auto count = allocations.load() - start_ - excluded_;
+    state_.counters["allocations"] = benchmark::Counter(static_cast<double>(count), benchmark::Counter::kAvgIterations);
+    if(count != 0)
+    {
+      state_.SkipWithError("The control loop allocated");
+    }
+  }
+
+  /** Stop counting, e.g. while preparing the next iteration */
+  void pause()
+  {
+    paused_ = allocations.load();
+  }
+
+  void resume()
+  {
+    excluded_ += allocations.load() - paused_;
+  }
+
+private:
+  benchmark::State & state_;
+  uint64_t start_;
+  uint64_t paused_ = 0;
+  uint64_t excluded_ = 0;
+};
+
+/** Feed msg to the subscriber and make it visible to the control thread */
+void feed(WhyConSubscriber & subscriber, whycon_lshape::WhyConLShapeMsg & msg)
+{
+  msg.header.seq++;
+  subscriber.process(msg);
+  subscriber.tick(dt);
+}
+
+/** Processing of one message by the vision thread */
+void BM_Callback(benchmark::State & state)
+{
+  const auto n = static_cast<size_t>(state.range(0));
+  mc_control::MCController ctl(robotModule(), dt);
+  WhyConSubscriber subscriber(ctl, subscriberConfig(n));
+  auto msg = makeMessage(n);
+  for(auto _ : state)
+  {
+    msg.header.seq++;
+    subscriber.process(msg);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK(BM_Callback)->Arg(1)->Arg(10)->Arg(50)->Arg(100)->Arg(500);
+
+/** tick() when no new measurement is available */
+void BM_TickIdle(benchmark::State & state)
+{
+  const auto n = static_cast<size_t>(state.range(0));
+  mc_control::MCController ctl(robotModule(), dt);
+  WhyConSubscriber subscriber(ctl, subscriberConfig(n));
+  auto msg = makeMessage(n);
+  // The first tick registers the markers in the logger and GUI
+  feed(subscriber, msg);
+  for(auto _ : state)
+  {
+    subscriber.tick(dt);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK(BM_TickIdle)->Arg(1)->Arg(10)->Arg(50)->Arg(100)->Arg(500);
+
+/** process() followed by tick(): every marker is fresh on each tick */
+void BM_ProcessAndTick(benchmark::State & state)
+{
+  const auto n = static_cast<size_t>(state.range(0));
+  mc_control::MCController ctl(robotModule(), dt);
+  WhyConSubscriber subscriber(ctl, subscriberConfig(n));
+  auto msg = makeMessage(n);
+  feed(subscriber, msg);
+  for(auto _ : state)
+  {
+    feed(subscriber, msg);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * n));
+}
+BENCHMARK(BM_ProcessAndTick)->Arg(1)->Arg(10)->Arg(50)->Arg(100)->Arg(500);
+
+/** WhyConUpdater::update on a PBVS task
+ *
+ * Argument: 0 between two frames (the update is skipped), 1 when the error is
+ * recomputed on every iteration
+ */
+void BM_UpdaterUpdate(benchmark::State & state)
+{
+  const bool recompute = state.range(0) != 0;
+  mc_control::MCController ctl(robotModule(), dt);
+  WhyConSubscriber subscriber(ctl, subscriberConfig(2));
+  auto msg = makeMessage(2);
+  feed(subscriber, msg);
+  mc_tasks::PositionBasedVisServoTask task(ctl.robot().frame("R_WRIST_Y_S"), sva::PTransformd::Identity(), 2.0, 500.0);
+  WhyConUpdater updater(subscriber, subscriber.handle(markerName(0)), subscriber.handle(markerName(1)));
+  // The first update prints the transforms
+  updater.update(task);
+  {
+    AllocationCheck check(state);
+    for(auto _ : state)
+    {
+      if(recompute)
+      { // Invalidates the last update
+        updater.frameOffset(updater.frameOffset());
+      }
+      benchmark::DoNotOptimize(updater.update(task));
+    }
+  }
+}
+BENCHMARK(BM_UpdaterUpdate)->Arg(0)->Arg(1);
+
+/** ApproachVisualServoing::run while visual servoing is active
+ *
+ * The convergence thresholds are zero so that every iteration goes through
+ * updatePBVSTask(), the PBVS loop must not allocate.
+ *
+ * Argument: 0 between two frames (the error is kept), 1 when a new frame is
+ * fed before every iteration so that the error is recomputed (feeding the
+ * frame is neither timed nor counted)
+ */
+void BM_ApproachVisualServoing(benchmark::State & state)
+{
+  const bool recompute = state.range(0) != 0;
+  mc_control::fsm::Controller ctl(robotModule(), dt, mc_rtc::Configuration{});
+  auto subscriber = std::make_shared<WhyConSubscriber>(ctl, subscriberConfig(2));
+  ctl.datastore().make_call("WhyconPlugin::getWhyconSubscriber", [subscriber]() { return subscriber; });
+  auto msg = makeMessage(2);
+  feed(*subscriber, msg);
+
+  mc_rtc::Configuration config;
+  auto robot = config.add("robot");
+  robot.add("marker", markerName(0));
+  robot.add("frame", std::string("RightGripper"));
+  auto target = config.add("target");
+  target.add("marker", markerName(1));
+  target.add("frame", std::string("LeftGripper"));
+  auto approach = config.add("approach");
+  approach.add("use", false);
+  approach.add("duration", 1.0);
+  approach.add("stiffness", 1.0);
+  approach.add("weight", 1.0);
+  approach.add("completion").add("timeElapsed", true);
+  auto vs = config.add("visualServoing");
+  vs.add("manualConfirmation", false);
+  vs.add("eval", 0.0);
+  vs.add("speed", 0.0);
+
+  ApproachVisualServoing avs;
+  avs.configure(config);
+  avs.start(ctl);
+  // Completes the (disabled) approach and enables visual servoing
+  avs.run(ctl);
+  {
+    AllocationCheck check(state);
+    for(auto _ : state)
+    {
+      if(recompute)
+      {
+        state.PauseTiming();
+        check.pause();
+        feed(*subscriber, msg);
+        check.resume();
+        state.ResumeTiming();
+      }
+      benchmark::DoNotOptimize(avs.run(ctl));
+    }
+  }
+  avs.teardown(ctl);
+}
+BENCHMARK(BM_ApproachVisualServoing)->Arg(0)->Arg(1);
+
+} // namespace
+
+BENCHMARK_MAIN();
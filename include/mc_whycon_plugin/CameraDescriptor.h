@@ -0,0 +1,23 @@
+#pragma once
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+#include <string>
+
+namespace whycon_plugin
+{
+
+/** Static description of a camera, read from the configuration */
+struct CameraDescriptor
+{
+  /** Name of the camera */
+  std::string name{};
+  /** Robot carrying the camera */
+  std::string robot{};
+  /** Frame on the robot to which the camera is attached */
+  std::string frame{};
+  /** Offset from the frame to the camera optical frame */
+  sva::PTransformd offset = sva::PTransformd::Identity();
+};
+
+} // namespace whycon_plugin
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "MarkerStorage.h"
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+namespace whycon_plugin
+{
+
+/** Fixed-size history of timestamped camera poses
+ *
+ * The control thread pushes the camera pose every iteration, measurements are
+ * then composed with the camera pose interpolated at their capture time so
+ * that the camera motion during the detector latency does not show up in the
+ * world position of the markers.
+ *
+ * All storage is allocated at construction, push() and at() never allocate.
+ */
+struct CameraPoseHistory
+{
+  /** Create a history holding at most capacity samples */
+  explicit CameraPoseHistory(size_t capacity = 512);
+
+  /** Add a sample, timestamps are expected to be increasing
+   *
+   * If t is older than the newest sample (e.g. the clock was reset) the
+   * history is cleared first.
+   */
+  void push(double t, const sva::PTransformd & X_0_camera);
+
+  /** Camera pose at time t
+   *
+   * The pose is interpolated between the two samples surrounding t. If t is
+   * outside of the stored time range the closest sample is returned. If the
+   * history is empty, identity is returned.
+   */
+  sva::PTransformd at(double t) const;
+
+  /** Remove all samples */
+  inline void clear() noexcept
+  {
+    size_ = 0;
+  }
+
+  /** Number of stored samples */
+  inline size_t size() const noexcept
+  {
+    return size_;
+  }
+
+  inline size_t capacity() const noexcept
+  {
+    return stamps_.size();
+  }
+
+  /** Timestamp of the oldest sample */
+  double oldest() const noexcept;
+
+  /** Timestamp of the newest sample */
+  double newest() const noexcept;
+
+private:
+  aligned_vector<double> stamps_;
+  aligned_vector<sva::PTransformd> poses_;
+  /** Index of the next sample to write */
+  size_t head_ = 0;
+  size_t size_ = 0;
+
+  /** Storage index of the i-th sample, 0 being the oldest */
+  inline size_t index(size_t i) const noexcept
+  {
+    return (head_ + capacity() - size_ + i) % capacity();
+  }
+};
+
+} // namespace whycon_plugin
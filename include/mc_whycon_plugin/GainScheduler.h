@@ -0,0 +1,169 @@
+#pragma once
+
+#include <mc_rtc/Configuration.h>
+
+#include <memory>
+
+namespace whycon_plugin
+{
+
+/** Configuration of a GainScheduler
+ *
+ * \code{.yaml}
+ * gainScheduler:
+ *   # heuristic: multiply the stiffness by factor after period slow iterations
+ *   # adaptive: continuously adapt the stiffness to the error-decrease rate
+ *   type: heuristic
+ *   # heuristic
+ *   period: 100
+ *   factor: 2.0
+ *   # adaptive
+ *   # Desired time constant of the error decay [s]
+ *   timeConstant: 1.0
+ *   # Relative change of the stiffness per second when the error decreases too slowly (or too fast)
+ *   adaptationRate: 2.0
+ *   # Time constant of the running average of the error-decrease rate [s]
+ *   smoothing: 0.1
+ *   # No adaptation if the last measurement is older than this, the stiffness relaxes to its nominal value [s]
+ *   maxAge: 0.2
+ * \endcode
+ */
+struct GainSchedulerConfig
+{
+  enum class Type
+  {
+    /** Multiply the stiffness after a number of iterations without progress */
+    Heuristic,
+    /** Adapt the stiffness from the error, its decrease rate and the measurement freshness */
+    Adaptive
+  };
+
+  Type type = Type::Heuristic;
+  unsigned int period = 100;
+  double factor = 2.0;
+  double timeConstant = 1.0;
+  double adaptationRate = 2.0;
+  double smoothing = 0.1;
+  double maxAge = 0.2;
+
+  /** Load the configuration, entries that are not present keep their current value */
+  void load(const mc_rtc::Configuration & config);
+};
+
+/** State of the servoing loop seen by a GainScheduler */
+struct GainSchedulerInput
+{
+  /** Norm of the translation error [m] */
+  double error = 0;
+  /** Speed of the controlled frame [m/s] */
+  double speed = 0;
+  /** Speed below which the task is considered as stalled [m/s] */
+  double speedThreshold = 0;
+  /** Maximum speed allowed for the controlled frame [m/s] */
+  double maxSpeed = 0;
+  /** Time since the last measurement of the markers [s] */
+  double age = 0;
+  /** Control period [s] */
+  double dt = 0;
+};
+
+/** Choose the stiffness of a servoing task from the convergence of its error */
+struct GainScheduler
+{
+  /** Constructor
+   *
+   * \param stiffness Nominal (and initial) stiffness
+   *
+   * \param maxStiffness Maximum stiffness
+   */
+  GainScheduler(double stiffness, double maxStiffness) : nominal_(stiffness), max_(maxStiffness), k_(stiffness) {}
+
+  virtual ~GainScheduler() = default;
+
+  /** Update the stiffness, called once per control iteration */
+  virtual double update(const GainSchedulerInput & input) = 0;
+
+  /** Go back to the nominal stiffness */
+  virtual void reset()
+  {
+    k_ = nominal_;
+  }
+
+  inline double stiffness() const noexcept
+  {
+    return k_;
+  }
+
+  inline double maxStiffness() const noexcept
+  {
+    return max_;
+  }
+
+  inline void maxStiffness(double s) noexcept
+  {
+    max_ = s;
+  }
+
+protected:
+  double nominal_;
+  double max_;
+  double k_;
+};
+
+/** Multiply the stiffness every period iterations where the task is slower
+ * than speedThreshold, up to the maximum stiffness */
+struct HeuristicGainScheduler : public GainScheduler
+{
+  HeuristicGainScheduler(double stiffness, double maxStiffness, const GainSchedulerConfig & config)
+  : GainScheduler(stiffness, maxStiffness), config_(config)
+  {
+  }
+
+  double update(const GainSchedulerInput & input) override;
+
+  void reset() override;
+
+private:
+  GainSchedulerConfig config_;
+  unsigned int iter_ = 0;
+};
+
+/** Continuously adapt the stiffness to the decrease rate of the error
+ *
+ * The error should decay with the configured time constant, limited by the
+ * maximum speed. The stiffness grows exponentially while the (averaged)
+ * decrease rate is below this target and shrinks while it is above, which
+ * limits the overshoot near convergence. The stiffness is kept between its
+ * nominal and maximum values and relaxes to the nominal value while the
+ * measurements are stale.
+ */
+struct AdaptiveGainScheduler : public GainScheduler
+{
+  AdaptiveGainScheduler(double stiffness, double maxStiffness, const GainSchedulerConfig & config)
+  : GainScheduler(stiffness, maxStiffness), config_(config)
+  {
+  }
+
+  double update(const GainSchedulerInput & input) override;
+
+  void reset() override;
+
+  /** Averaged decrease rate of the error [m/s] */
+  inline double rate() const noexcept
+  {
+    return rate_;
+  }
+
+private:
+  GainSchedulerConfig config_;
+  /** Error at the previous update, negative before the first update */
+  double error_ = -1;
+  double rate_ = 0;
+};
+
+/** Create the scheduler selected by config.type */
+std::unique_ptr<GainScheduler> makeGainScheduler(double stiffness,
+                                                 double maxStiffness,
+                                                 const GainSchedulerConfig & config);
+
+} // namespace whycon_plugin
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <mc_control/mc_controller.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+
+namespace whycon_plugin
+{
+
+/** Histogram of durations with logarithmic buckets
+ *
+ * Buckets are spaced by a quarter of an octave from 100 ns to about 10 s, so
+ * percentiles are reported with a resolution of about 20%.
+ *
+ * record() is wait-free and does not allocate. It must be called from a
+ * single thread, the statistics can be read from any thread.
+ */
+struct LatencyHistogram
+{
+  static constexpr size_t BucketsPerOctave = 4;
+  static constexpr size_t NBuckets = 27 * BucketsPerOctave;
+  /** Lower bound of the first bucket [s] */
+  static constexpr double MinValue = 1e-7;
+
+  /** Record a duration [s] */
+  void record(double value) noexcept;
+
+  /** Value below which a fraction p of the recorded samples fall [s] */
+  double percentile(double p) const noexcept;
+
+  /** Largest recorded value [s] */
+  inline double max() const noexcept
+  {
+    return max_.load(std::memory_order_relaxed);
+  }
+
+  /** Last recorded value [s] */
+  inline double last() const noexcept
+  {
+    return last_.load(std::memory_order_relaxed);
+  }
+
+  /** Number of recorded samples */
+  inline uint64_t count() const noexcept
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+  /** Clear the histogram, samples recorded concurrently may be lost */
+  void reset() noexcept;
+
+private:
+  std::array<std::atomic<uint64_t>, NBuckets> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<double> max_{0};
+  std::atomic<double> last_{0};
+};
+
+/** Record the lifetime of this object in a histogram */
+struct ScopedTimer
+{
+  using clock = std::chrono::steady_clock;
+
+  ScopedTimer(LatencyHistogram & histogram) : histogram_(histogram), start_(clock::now()) {}
+
+  ~ScopedTimer()
+  {
+    histogram_.record(std::chrono::duration<double>(clock::now() - start_).count());
+  }
+
+private:
+  LatencyHistogram & histogram_;
+  clock::time_point start_;
+};
+
+/** Collection of named timing stages
+ *
+ * Each stage is displayed (p50/p99/max) in the GUI under the category
+ * provided at construction and logged as <prefix>_<stage>_{p50,p99,max}.
+ * Computing a percentile scans the histogram: the logged percentiles are
+ * refreshed every RefreshPeriod log iterations (stages are staggered) and
+ * cached in between, the GUI computes them when it is displayed.
+ */
+struct Instrumentation
+{
+  /** Number of log iterations between two refreshes of the logged percentiles */
+  static constexpr uint64_t RefreshPeriod = 100;
+
+  Instrumentation(mc_control::MCController & ctl,
+                  const std::vector<std::string> & category,
+                  const std::string & logPrefix);
+
+  ~Instrumentation();
+
+  Instrumentation(const Instrumentation &) = delete;
+  Instrumentation & operator=(const Instrumentation &) = delete;
+
+  /** Get a stage, creating it if needed
+   *
+   * Creating a stage allocates and registers GUI and log entries, this should
+   * only be done from the control thread at configuration time. The returned
+   * reference remains valid for the lifetime of this object.
+   */
+  LatencyHistogram & stage(const std::string & name);
+
+  /** Clear every stage */
+  void reset();
+
+private:
+  struct Stage
+  {
+    std::string name;
+    LatencyHistogram histogram;
+    /** Logged percentiles, refreshed every RefreshPeriod log iterations [s] */
+    double p50 = 0;
+    double p99 = 0;
+    /** Log iterations, starts at the index of the stage to stagger the refreshes */
+    uint64_t iter = 0;
+  };
+  mc_control::MCController & ctl_;
+  std::vector<std::string> category_;
+  std::string logPrefix_;
+  std::deque<Stage> stages_;
+};
+
+} // namespace whycon_plugin
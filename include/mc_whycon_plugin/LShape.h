@@ -2,27 +2,59 @@
 
 #include <SpaceVecAlg/SpaceVecAlg>
 
+#include <cstdint>
+#include <string>
+
 namespace whycon_plugin
 {
 
+/** Default time after which a marker that has not been updated is considered not visible [s] */
+constexpr double LSHAPE_VISIBILITY_TIMEOUT = 0.5;
+
+/** Static description of a marker, read from the configuration */
+struct MarkerDescriptor
+{
+  /** Name of the marker */
+  std::string name{};
+  /** Robot to which the shape is attached */
+  std::string robot{};
+  /** Frame on the robot to which the shape is attached */
+  std::string frame{};
+  /** Offset relative to the frame on the robot */
+  sva::PTransformd frameOffset = sva::PTransformd::Identity();
+};
+
 /** Represent an L-shape detected by the WhyCon detector */
-struct LShape
+struct LShape : public MarkerDescriptor
 {
+  LShape() = default;
+
+  /** Build an l-shape from its description and current estimate */
+  LShape(const MarkerDescriptor & descriptor,
+         bool visible,
+         double confidence,
+         const sva::PTransformd & pos,
+         const sva::PTransformd & posW,
+         double lastUpdate)
+  : MarkerDescriptor(descriptor), visible(visible), confidence(confidence), pos(pos), posW(posW),
+    lastUpdate_(lastUpdate)
+  {
+  }
+
   /** True if the l-shape is visible */
   bool visible = false;
+  /** Confidence in the last update, in [0, 1] */
+  double confidence = 0;
   /** Position of the l-shape in the camera frame */
   sva::PTransformd pos = sva::PTransformd::Identity();
   /** Position of the l-shape in the world frame (estimated) */
   sva::PTransformd posW = sva::PTransformd::Identity();
 
-  /** Robot to which the shape is attached */
-  std::string robot{};
-  /** Frame on the robot to which the shape is attached */
-  std::string frame{};
-  /** Offset relative to the frame on the robot */
-  sva::PTransformd frameOffset = sva::PTransformd::Identity();
-
-  /** Tick every iteration to update the visibility */
+  /** Tick every iteration to update the visibility
+   *
+   * This applies the fixed LSHAPE_VISIBILITY_TIMEOUT, the markers tracked by
+   * WhyConSubscriber use the adaptive MarkerVisibility instead
+   */
   void tick(double dt);
   /** Called to update the position of the marker from the vision system */
   void update(const sva::PTransformd & in, const sva::PTransformd & X_0_camera);
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <mc_rtc/Configuration.h>
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+namespace whycon_plugin
+{
+
+/** Filtered state of a marker in the world frame */
+struct MarkerEstimate
+{
+  /** Filtered world position of the marker */
+  sva::PTransformd pose = sva::PTransformd::Identity();
+  /** Estimated velocity of the marker in the world frame (angular, linear) */
+  sva::MotionVecd velocity = sva::MotionVecd(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  /** Covariance of the pose (angular, linear) */
+  Eigen::Matrix<double, 6, 6> covariance = Eigen::Matrix<double, 6, 6>::Zero();
+  /** Covariance of the velocity (angular, linear) */
+  Eigen::Matrix<double, 6, 6> velocityCovariance = Eigen::Matrix<double, 6, 6>::Zero();
+};
+
+/** Configuration of a MarkerFilter
+ *
+ * \code{.yaml}
+ * filter:
+ *   # none, alphabeta or kalman
+ *   type: kalman
+ *   # alpha-beta gains
+ *   alpha: 0.5
+ *   beta: 0.1
+ *   # kalman noise model (standard deviations)
+ *   positionNoise: 0.005 # [m]
+ *   orientationNoise: 0.02 # [rad]
+ *   linearAcceleration: 0.5 # [m/s^2]
+ *   angularAcceleration: 1.0 # [rad/s^2]
+ *   # Time without measurement after which the filter is reset on the next measurement [s]
+ *   timeout: 0.5
+ * \endcode
+ */
+struct MarkerFilterConfig
+{
+  enum class Type
+  {
+    /** No filtering, the estimate follows the measurements */
+    None,
+    /** Constant gains alpha-beta filter */
+    AlphaBeta,
+    /** Constant-velocity Kalman filter */
+    Kalman
+  };
+
+  Type type = Type::None;
+  double alpha = 0.5;
+  double beta = 0.1;
+  double positionNoise = 0.005;
+  double orientationNoise = 0.02;
+  double linearAcceleration = 0.5;
+  double angularAcceleration = 1.0;
+  double timeout = 0.5;
+
+  /** Load the configuration, entries that are not present keep their current value */
+  void load(const mc_rtc::Configuration & config);
+};
+
+/** Constant-velocity estimator of a marker pose
+ *
+ * The prediction runs at the control rate, corrections happen whenever a new
+ * measurement is available. The six degrees of freedom are filtered
+ * independently on the tangent space of SE(3): rotations are handled through
+ * their rotation vector in the world frame.
+ *
+ * Measurements are taken at their capture time: the innovation is computed
+ * against the state extrapolated back to the capture time and the correction
+ * is applied to the current state.
+ */
+struct MarkerFilter
+{
+  MarkerFilter() = default;
+
+  explicit MarkerFilter(const MarkerFilterConfig & config) : config_(config) {}
+
+  inline const MarkerFilterConfig & config() const noexcept
+  {
+    return config_;
+  }
+
+  /** Propagate the estimate by dt */
+  void predict(double dt);
+
+  /** Correct the estimate with a measurement
+   *
+   * \param X_0_marker Measured world position of the marker
+   *
+   * \param age Time elapsed since the measurement was captured [s]
+   */
+  void correct(const sva::PTransformd & X_0_marker, double age);
+
+  /** Re-initialize the estimate on a measurement, the velocity is reset to zero */
+  void reset(const sva::PTransformd & X_0_marker);
+
+  /** Difference between a measurement and the estimate extrapolated back to its capture time
+   *
+   * \param X_0_marker Measured world position of the marker
+   *
+   * \param age Time elapsed since the measurement was captured [s]
+   *
+   * \param angular Rotation vector from the prediction to the measurement (world frame)
+   *
+   * \param linear Translation from the prediction to the measurement (world frame)
+   *
+   * \returns False if there is no estimate to compare with (no measurement
+   * yet or no measurement for longer than the timeout)
+   */
+  bool innovation(const sva::PTransformd & X_0_marker,
+                  double age,
+                  Eigen::Vector3d & angular,
+                  Eigen::Vector3d & linear) const;
+
+  /** Time since the last correction [s] */
+  inline double sinceCorrection() const noexcept
+  {
+    return sinceCorrection_;
+  }
+
+  /** Current estimate */
+  inline const MarkerEstimate & estimate() const noexcept
+  {
+    return estimate_;
+  }
+
+  /** True once the filter received its first measurement */
+  inline bool initialized() const noexcept
+  {
+    return initialized_;
+  }
+
+private:
+  MarkerFilterConfig config_;
+  MarkerEstimate estimate_;
+  bool initialized_ = false;
+  /** Time since the last correction */
+  double sinceCorrection_ = 0;
+  /** Rotation from the marker to the world frame (R = E^T) */
+  Eigen::Matrix3d R_ = Eigen::Matrix3d::Identity();
+  /** Covariance of the [position, velocity] pair for one linear/angular axis */
+  Eigen::Matrix2d Plin_ = Eigen::Matrix2d::Zero();
+  Eigen::Matrix2d Pang_ = Eigen::Matrix2d::Zero();
+
+  void updateEstimate();
+};
+
+} // namespace whycon_plugin
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <mc_rtc/Configuration.h>
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+#include <cstddef>
+
+namespace whycon_plugin
+{
+
+/** Configuration of the MarkerFusion
+ *
+ * \code{.yaml}
+ * fusion:
+ *   # Standard deviation of a measurement taken at 1m from the camera, it is
+ *   # scaled by distance^distanceExponent
+ *   positionNoise: 0.002 # [m]
+ *   orientationNoise: 0.02 # [rad]
+ *   distanceExponent: 2.0
+ *   # Expected motion of the markers, an observation older than the newest one
+ *   # by dt has its standard deviation increased by dt * velocity
+ *   velocity: 0.5 # [m/s]
+ *   angularVelocity: 1.0 # [rad/s]
+ *   # Observations older than the newest one by more than this are ignored [s]
+ *   window: 0.1
+ * \endcode
+ */
+struct MarkerFusionConfig
+{
+  double positionNoise = 0.002;
+  double orientationNoise = 0.02;
+  double distanceExponent = 2.0;
+  double velocity = 0.5;
+  double angularVelocity = 1.0;
+  double window = 0.1;
+
+  /** Load the configuration, entries that are not present keep their current value */
+  void load(const mc_rtc::Configuration & config);
+};
+
+/** Latest observation of a marker by one camera */
+struct MarkerObservation
+{
+  /** World position of the marker */
+  sva::PTransformd X_0_marker = sva::PTransformd::Identity();
+  /** Distance between the camera and the marker [m] */
+  double distance = 0;
+  /** Capture time [s] */
+  double stamp = 0;
+  /** Index of the camera, not used by the fusion */
+  size_t camera = 0;
+};
+
+/** Combine the observations of a marker by several cameras into a single world estimate
+ *
+ * Every observation is weighted by the inverse of its variance: the noise of
+ * the detector grows with the distance to the camera and observations older
+ * than the newest one are penalized by the motion the marker could have done
+ * in the meantime. Translations are averaged directly, rotations are averaged
+ * on the tangent space of the most confident observation.
+ *
+ * A single observation is returned unchanged.
+ */
+struct MarkerFusion
+{
+  explicit MarkerFusion(const MarkerFusionConfig & config = {}) : config_(config) {}
+
+  inline const MarkerFusionConfig & config() const noexcept
+  {
+    return config_;
+  }
+
+  /** Fuse observations of a marker
+   *
+   * \param observations Observations of the marker, at least one
+   *
+   * \param n Number of observations
+   *
+   * \param X_0_marker Fused world position
+   *
+   * \param stamp Capture time of the newest observation [s]
+   *
+   * \returns Index of the most confident observation
+   */
+  size_t fuse(const MarkerObservation * observations, size_t n, sva::PTransformd & X_0_marker, double & stamp) const;
+
+private:
+  MarkerFusionConfig config_;
+};
+
+} // namespace whycon_plugin
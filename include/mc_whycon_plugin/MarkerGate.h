@@ -0,0 +1,135 @@
+#pragma once
+
+#include "MarkerFilter.h"
+
+#include <mc_rtc/Configuration.h>
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+#include <cstdint>
+
+namespace whycon_plugin
+{
+
+/** Configuration of a MarkerGate
+ *
+ * \code{.yaml}
+ * gating:
+ *   # Opt-in, the measurements are not gated by default
+ *   enabled: true
+ *   # Measurements whose squared Mahalanobis distance to the prediction is
+ *   # above this are rejected (0 to disable), 22.46 is the 99.9% quantile of
+ *   # the chi-square distribution with 6 degrees of freedom
+ *   threshold: 22.46
+ *   # Standard deviation of the measurements, added to the covariance of the filter
+ *   positionNoise: 0.01 # [m]
+ *   orientationNoise: 0.05 # [rad]
+ *   # Motion allowed since the last accepted measurement, added to the
+ *   # covariance of the filter
+ *   velocity: 0.5 # [m/s]
+ *   angularVelocity: 2.0 # [rad/s]
+ *   # Measurements rotated by more than this from the prediction are rejected as flipped L-shapes (0 to disable)
+ *   flipAngle: 120 # [deg]
+ *   # After this many consecutive rejections the measurement is accepted and the filter is reset
+ *   maxRejections: 5
+ * \endcode
+ */
+struct MarkerGateConfig
+{
+  bool enabled = false;
+  double threshold = 22.46;
+  double positionNoise = 0.01;
+  double orientationNoise = 0.05;
+  double velocity = 0.5;
+  double angularVelocity = 2.0;
+  double flipAngle = 120;
+  unsigned int maxRejections = 5;
+
+  /** Load the configuration, entries that are not present keep their current value */
+  void load(const mc_rtc::Configuration & config);
+};
+
+/** Reject the measurements of a marker that are inconsistent with its estimate
+ *
+ * Measurements are compared with the filter estimate extrapolated to their
+ * capture time. The innovation is normalized by the covariance of the filter
+ * (if any), the measurement noise and the motion the marker could have done
+ * since the last accepted measurement.
+ *
+ * A marker that genuinely jumped (e.g. moved while hidden) would be rejected
+ * forever: after maxRejections consecutive rejections the measurement is
+ * accepted and the caller must reset the filter.
+ */
+struct MarkerGate
+{
+  enum class Result
+  {
+    /** Consistent with the estimate */
+    Accepted,
+    /** Too far from the estimate */
+    Outlier,
+    /** Rotated by more than flipAngle from the estimate */
+    Flip,
+    /** Accepted after too many consecutive rejections, the filter must be reset */
+    Recovered
+  };
+
+  MarkerGate() = default;
+
+  explicit MarkerGate(const MarkerGateConfig & config) : config_(config) {}
+
+  inline const MarkerGateConfig & config() const noexcept
+  {
+    return config_;
+  }
+
+  /** Check a measurement against the estimate of the filter
+   *
+   * \param filter Filter of the marker, not yet corrected with this measurement
+   *
+   * \param X_0_marker Measured world position of the marker
+   *
+   * \param age Time elapsed since the measurement was captured [s]
+   */
+  Result check(const MarkerFilter & filter, const sva::PTransformd & X_0_marker, double age);
+
+  /** Squared Mahalanobis distance of the last checked measurement */
+  inline double distance() const noexcept
+  {
+    return distance_;
+  }
+
+  /** Number of measurements rejected as outliers */
+  inline uint64_t outliers() const noexcept
+  {
+    return outliers_;
+  }
+
+  /** Number of measurements rejected as flipped */
+  inline uint64_t flips() const noexcept
+  {
+    return flips_;
+  }
+
+  /** Number of times a measurement was accepted after maxRejections rejections */
+  inline uint64_t recoveries() const noexcept
+  {
+    return recoveries_;
+  }
+
+  /** Reset the counters */
+  inline void clear() noexcept
+  {
+    outliers_ = flips_ = recoveries_ = 0;
+  }
+
+private:
+  MarkerGateConfig config_;
+  double distance_ = 0;
+  unsigned int consecutive_ = 0;
+  uint64_t outliers_ = 0;
+  uint64_t flips_ = 0;
+  uint64_t recoveries_ = 0;
+};
+
+} // namespace whycon_plugin
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+namespace whycon_plugin
+{
+
+/** Dense index of a marker in the subscriber's storage
+ *
+ * Handles are resolved once from the marker name (see
+ * WhyConSubscriber::handle) and remain valid for the lifetime of the
+ * subscriber. Accessing a marker through its handle is a plain array access.
+ */
+struct MarkerHandle
+{
+  static constexpr uint32_t invalid = std::numeric_limits<uint32_t>::max();
+
+  MarkerHandle() = default;
+
+  explicit MarkerHandle(uint32_t idx) : index(idx) {}
+
+  /** Index of the marker in the subscriber's storage */
+  uint32_t index = invalid;
+
+  inline bool valid() const noexcept
+  {
+    return index != invalid;
+  }
+
+  inline bool operator==(const MarkerHandle & rhs) const noexcept
+  {
+    return index == rhs.index;
+  }
+
+  inline bool operator!=(const MarkerHandle & rhs) const noexcept
+  {
+    return index != rhs.index;
+  }
+};
+
+} // namespace whycon_plugin
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "SpscRing.h"
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace whycon_plugin
+{
+
+/** Binary recording of the marker measurements and camera poses
+ *
+ * Layout (host byte order):
+ * - header: "WHYCOREC" (8 bytes), version (uint32), number of markers
+ *   (uint32) then for each marker the length of its name (uint32) followed by
+ *   the name, then the cameras in the same way
+ * - records, sorted by reception time within each write:
+ *   - camera pose: type 0 (uint8), camera index (uint8), time (double), pose
+ *     (7 doubles)
+ *   - measurement: type 1 (uint8), camera index (uint8), marker index
+ *     (uint32), capture time (double), reception time (double), pose in the
+ *     camera frame (7 doubles)
+ *
+ * Poses are stored as a quaternion (w, x, y, z) followed by the translation.
+ *
+ * Version 1 recordings (single camera, no camera list nor camera index) can
+ * still be read, their records are attributed to a camera named "camera".
+ */
+namespace recording
+{
+
+constexpr char Magic[8] = {'W', 'H', 'Y', 'C', 'O', 'R', 'E', 'C'};
+constexpr uint32_t Version = 2;
+
+enum class RecordType : uint8_t
+{
+  Camera = 0,
+  Measurement = 1
+};
+
+/** A single entry of a recording */
+struct Record
+{
+  RecordType type = RecordType::Camera;
+  /** Index of the camera in the recording */
+  uint8_t camera = 0;
+  /** Index of the marker in the recording (measurements only) */
+  uint32_t marker = 0;
+  /** Capture time of the measurement or time of the camera pose [s] */
+  double stamp = 0;
+  /** Reception time of the measurement, equal to stamp for camera poses [s] */
+  double received = 0;
+  /** Camera pose in the world or marker pose in the camera frame */
+  sva::PTransformd pose = sva::PTransformd::Identity();
+};
+
+} // namespace recording
+
+/** Record the measurements and camera poses to a file
+ *
+ * Every producer has its own preallocated queue: the measurements of each
+ * camera and the poses of each camera. A background thread drains the queues
+ * and writes them to disk, so that neither the vision nor the control thread
+ * performs I/O, takes a lock or allocates. Records that do not fit in a full
+ * queue are dropped and counted, see overflows().
+ *
+ * For a given camera, measurement() and camera() must each be called from a
+ * single thread, different cameras can be recorded concurrently.
+ */
+struct MarkerRecorder
+{
+  /** Open the file and write the header
+   *
+   * \param path Output file, truncated if it exists
+   *
+   * \param markers Names of the markers, their index in this list is used to
+   * identify them in the records
+   *
+   * \param cameras Names of the cameras, identified the same way
+   *
+   * \param capacity Number of records queued by each producer until the
+   * writer thread drains them
+   *
+   * \throws If the file cannot be opened
+   */
+  MarkerRecorder(const std::string & path,
+                 const std::vector<std::string> & markers,
+                 const std::vector<std::string> & cameras,
+                 size_t capacity = 4096);
+
+  /** Write the pending records and close the file */
+  ~MarkerRecorder();
+
+  MarkerRecorder(const MarkerRecorder &) = delete;
+  MarkerRecorder & operator=(const MarkerRecorder &) = delete;
+
+  /** Record the pose of a camera at time t */
+  void camera(uint8_t camera, double t, const sva::PTransformd & X_0_camera);
+
+  /** Record a measurement of a marker by a camera */
+  void measurement(uint8_t camera,
+                   uint32_t marker,
+                   double stamp,
+                   double received,
+                   const sva::PTransformd & X_camera_marker);
+
+  inline const std::string & path() const noexcept
+  {
+    return path_;
+  }
+
+  /** Number of records dropped because a queue was full */
+  uint64_t overflows() const noexcept;
+
+private:
+  std::string path_;
+  std::ofstream out_;
+  /** Only used to wake up the writer thread when stopping */
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_ = true;
+  /** Measurements of each camera */
+  std::vector<std::unique_ptr<SpscRing<recording::Record>>> measurements_;
+  /** Poses of each camera */
+  std::vector<std::unique_ptr<SpscRing<recording::Record>>> cameras_;
+  /** Records drained by the writer thread */
+  std::vector<recording::Record> pending_;
+  /** Serialized records, written by the writer thread */
+  std::vector<char> writing_;
+  std::thread writer_;
+
+  /** Drain every queue and write the records, called by the writer thread */
+  void flush();
+};
+
+/** Read a recording created by MarkerRecorder
+ *
+ * The file is read incrementally so that long recordings do not need to fit
+ * in memory.
+ */
+struct MarkerReplay
+{
+  /** Open a recording
+   *
+   * \throws If the file cannot be opened or is not a valid recording
+   */
+  MarkerReplay(const std::string & path);
+
+  /** Names of the recorded markers */
+  inline const std::vector<std::string> & markers() const noexcept
+  {
+    return markers_;
+  }
+
+  /** Names of the recorded cameras */
+  inline const std::vector<std::string> & cameras() const noexcept
+  {
+    return cameras_;
+  }
+
+  /** True once every record has been consumed */
+  inline bool done() const noexcept
+  {
+    return done_;
+  }
+
+  /** Next record, only valid if !done() */
+  inline const recording::Record & next() const noexcept
+  {
+    return next_;
+  }
+
+  /** Time of the next record (reception time for measurements) [s] */
+  inline double nextTime() const noexcept
+  {
+    return next_.received;
+  }
+
+  /** Consume the next record */
+  void pop();
+
+  inline const std::string & path() const noexcept
+  {
+    return path_;
+  }
+
+private:
+  std::string path_;
+  std::ifstream in_;
+  uint32_t version_ = recording::Version;
+  std::vector<std::string> markers_;
+  std::vector<std::string> cameras_;
+  recording::Record next_;
+  bool done_ = false;
+};
+
+} // namespace whycon_plugin
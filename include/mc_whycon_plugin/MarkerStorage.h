@@ -0,0 +1,310 @@
+#pragma once
+
+#include "LShape.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace whycon_plugin
+{
+
+/** Allocator aligning storage on a cache line so that arrays of per-marker
+ * data never share a line with unrelated data */
+template<typename T, size_t Alignment = 64>
+struct CacheAlignedAllocator
+{
+  using value_type = T;
+
+  template<typename U>
+  struct rebind
+  {
+    using other = CacheAlignedAllocator<U, Alignment>;
+  };
+
+  CacheAlignedAllocator() = default;
+
+  template<typename U>
+  CacheAlignedAllocator(const CacheAlignedAllocator<U, Alignment> &) noexcept
+  {
+  }
+
+  T * allocate(size_t n)
+  {
+    return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{Alignment}));
+  }
+
+  void deallocate(T * p, size_t) noexcept
+  {
+    ::operator delete(p, std::align_val_t{Alignment});
+  }
+
+  template<typename U>
+  bool operator==(const CacheAlignedAllocator<U, Alignment> &) const noexcept
+  {
+    return true;
+  }
+
+  template<typename U>
+  bool operator!=(const CacheAlignedAllocator<U, Alignment> &) const noexcept
+  {
+    return false;
+  }
+};
+
+template<typename T>
+using aligned_vector = std::vector<T, CacheAlignedAllocator<T>>;
+
+/** Latest measurements of every marker as published by the vision thread
+ *
+ * Stored as a structure of arrays indexed by MarkerHandle::index
+ */
+struct MarkerMeasurements
+{
+  /** Position of the marker in the camera frame */
+  aligned_vector<sva::PTransformd> pos;
+  /** Time at which the image was captured [s] */
+  aligned_vector<double> stamp;
+  /** Time at which the measurement was received [s] */
+  aligned_vector<double> received;
+  /** Number of measurements received so far */
+  aligned_vector<uint64_t> count;
+
+  inline void resize(size_t n)
+  {
+    pos.resize(n, sva::PTransformd::Identity());
+    stamp.resize(n, 0);
+    received.resize(n, 0);
+    count.resize(n, 0);
+  }
+
+  inline size_t size() const noexcept
+  {
+    return count.size();
+  }
+};
+
+/** Estimated state of every marker as seen by the control thread
+ *
+ * Stored as a structure of arrays indexed by MarkerHandle::index
+ */
+struct MarkerStates
+{
+  /** Non-zero if the marker is visible */
+  aligned_vector<uint8_t> visible;
+  /** Confidence in the last update, in [0, 1] (see MarkerVisibility) */
+  aligned_vector<double> confidence;
+  /** Non-zero if the marker received a new measurement during the last update */
+  aligned_vector<uint8_t> fresh;
+  /** Time since the last update [s] */
+  aligned_vector<double> lastUpdate;
+  /** Number of measurements consumed so far, this is the sequence number of
+   * the last sample: it only increases when the marker is updated */
+  aligned_vector<uint64_t> count;
+  /** Position of the marker in the camera frame */
+  aligned_vector<sva::PTransformd> pos;
+  /** Position of the marker in the world frame (estimated) */
+  aligned_vector<sva::PTransformd> posW;
+  /** Capture time of the last measurement [s] */
+  aligned_vector<double> stamp;
+  /** Delay between capture and reception of the last measurement [s] */
+  aligned_vector<double> latency;
+  /** Index of the camera that provided pos */
+  aligned_vector<uint32_t> camera;
+
+  inline void resize(size_t n)
+  {
+    visible.resize(n, 0);
+    confidence.resize(n, 0);
+    fresh.resize(n, 0);
+    lastUpdate.resize(n, 1.0);
+    count.resize(n, 0);
+    pos.resize(n, sva::PTransformd::Identity());
+    posW.resize(n, sva::PTransformd::Identity());
+    stamp.resize(n, 0);
+    latency.resize(n, 0);
+    camera.resize(n, 0);
+  }
+
+  inline size_t size() const noexcept
+  {
+    return count.size();
+  }
+
+  /** Set a new estimate of a marker, e.g. the fusion of several cameras' states */
+  inline void assign(size_t i,
+                     const sva::PTransformd & X_camera_marker,
+                     const sva::PTransformd & X_0_marker,
+                     double capture,
+                     double delay,
+                     uint32_t cam)
+  {
+    fresh[i] = 1;
+    count[i]++;
+    pos[i] = X_camera_marker;
+    posW[i] = X_0_marker;
+    stamp[i] = capture;
+    latency[i] = delay;
+    camera[i] = cam;
+    lastUpdate[i] = 0;
+  }
+
+  /** Integrate the latest measurements
+   *
+   * Only the markers that received a new measurement are updated, their world
+   * position is composed with the camera position at capture time.
+   *
+   * \param m Latest measurements
+   *
+   * \param X_0_camera Callable returning the camera position at a given time
+   *
+   * \returns The number of measurements that were superseded by a newer one
+   * before they could be consumed
+   */
+  template<typename CameraPoseAt>
+  inline uint64_t update(const MarkerMeasurements & m, CameraPoseAt && X_0_camera)
+  {
+    return update(m, std::forward<CameraPoseAt>(X_0_camera),
+                  [](size_t, const sva::PTransformd & X_camera_marker, const sva::PTransformd & X_0_cam)
+                  { return X_camera_marker * X_0_cam; });
+  }
+
+  /** Integrate the latest measurements with a custom world composition
+   *
+   * \param compose Callable (index, X_camera_marker, X_0_camera) returning the
+   * world position of a marker
+   *
+   * \see update(const MarkerMeasurements &, CameraPoseAt &&)
+   */
+  template<typename CameraPoseAt, typename Compose>
+  inline uint64_t update(const MarkerMeasurements & m, CameraPoseAt && X_0_camera, Compose && compose)
+  {
+    uint64_t conflated = 0;
+    const size_t n = size();
+    for(size_t i = 0; i < n; ++i)
+    {
+      fresh[i] = m.count[i] != count[i];
+      if(fresh[i])
+      {
+        conflated += m.count[i] - count[i] - 1;
+        count[i] = m.count[i];
+        pos[i] = m.pos[i];
+        posW[i] = compose(i, m.pos[i], X_0_camera(m.stamp[i]));
+        stamp[i] = m.stamp[i];
+        latency[i] = m.received[i] - m.stamp[i];
+        lastUpdate[i] = 0;
+      }
+    }
+    return conflated;
+  }
+
+  /** Advance the time since the last update of every marker, the visibility
+   * is then computed by MarkerVisibility::update() */
+  inline void tick(double dt) noexcept
+  {
+    const size_t n = size();
+    double * last = lastUpdate.data();
+    for(size_t i = 0; i < n; ++i)
+    {
+      last[i] += dt;
+    }
+  }
+};
+
+/** Latest state of a marker as published in the datastore
+ *
+ * <prefix>::Marker::<name> holds one sample per marker, the entries are
+ * created with the subscriber and overwritten by every tick()
+ */
+struct MarkerSample
+{
+  /** Position of the marker in the world frame (estimated) */
+  sva::PTransformd pose = sva::PTransformd::Identity();
+  /** Time since the last update [s] */
+  double age = 1.0;
+  /** Capture time of the last measurement [s] */
+  double stamp = 0;
+  /** Number of updates of the marker so far, increases with every new estimate */
+  uint64_t seq = 0;
+  /** True if the marker is visible */
+  bool visible = false;
+};
+
+/** Read-only view of a marker: its description and its latest state
+ *
+ * The view references the storage of the subscriber and never copies, it
+ * remains valid as long as the subscriber. It reads the MarkerStates, which
+ * are only written by tick() on the control thread (the vision threads write
+ * to the triple-buffered MarkerMeasurements), so it can be used anywhere on
+ * the control thread and always reflects the last tick().
+ */
+struct MarkerView
+{
+  MarkerView() = default;
+
+  MarkerView(const MarkerDescriptor & descriptor, const MarkerStates & states, uint32_t index)
+  : descriptor_(&descriptor), states_(&states), index_(index)
+  {
+  }
+
+  inline const MarkerDescriptor & descriptor() const noexcept
+  {
+    return *descriptor_;
+  }
+
+  inline const std::string & name() const noexcept
+  {
+    return descriptor_->name;
+  }
+
+  /** True if the marker is visible */
+  inline bool visible() const noexcept
+  {
+    return states_->visible[index_] != 0;
+  }
+
+  /** Confidence in the last update, in [0, 1] */
+  inline double confidence() const noexcept
+  {
+    return states_->confidence[index_];
+  }
+
+  /** Position of the marker in the camera frame */
+  inline const sva::PTransformd & pos() const noexcept
+  {
+    return states_->pos[index_];
+  }
+
+  /** Position of the marker in the world frame (estimated) */
+  inline const sva::PTransformd & posW() const noexcept
+  {
+    return states_->posW[index_];
+  }
+
+  /** Time since the last update [s] */
+  inline double lastUpdate() const noexcept
+  {
+    return states_->lastUpdate[index_];
+  }
+
+  /** Sequence number of the last update, see MarkerStates::count */
+  inline uint64_t seq() const noexcept
+  {
+    return states_->count[index_];
+  }
+
+  /** Capture time of the last measurement [s] */
+  inline double stamp() const noexcept
+  {
+    return states_->stamp[index_];
+  }
+
+private:
+  const MarkerDescriptor * descriptor_ = nullptr;
+  const MarkerStates * states_ = nullptr;
+  uint32_t index_ = 0;
+};
+
+} // namespace whycon_plugin
@@ -0,0 +1,472 @@
+#pragma once
+
+#include <mc_control/mc_controller.h>
+#include "CameraDescriptor.h"
+#include "CameraPoseHistory.h"
+#include "Instrumentation.h"
+#include "LShape.h"
+#include "MarkerFilter.h"
+#include "MarkerFusion.h"
+#include "MarkerGate.h"
+#include "MarkerHandle.h"
+#include "MarkerRecording.h"
+#include "MarkerStorage.h"
+#include "MarkerVisibility.h"
+#include "MeasurementSource.h"
+#include "TripleBuffer.h"
+#include "VisionSubscriber.h"
+
+#include <mc_rtc/Configuration.h>
+#include <mc_rtc/ros.h>
+#include <ros/ros.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace whycon_plugin
+{
+
+/** Subscribe to a marker detector to provide up-to-date information on the markers
+ *
+ * The markers can be seen by several cameras, each camera has its own
+ * measurement source (and thread), camera pose history and handoff to the
+ * control thread. tick() fuses the latest observations of every camera into
+ * a single world estimate per marker (see MarkerFusion).
+ *
+ * Everything specific to a detector is provided at compile time by Traits so
+ * that the message decoding is inlined in the subscription callback:
+ *
+ * \code{.cpp}
+ * struct Traits
+ * {
+ *   // ROS message published by the detector
+ *   using Message = ...;
+ *   // Static description of a marker, derived from MarkerDescriptor
+ *   using Descriptor = ...;
+ *   // Name used in the GUI, logs and messages, e.g. "WhyCon"
+ *   static constexpr const char * name = ...;
+ *   // Entry of the plugin configuration, e.g. "whycon"
+ *   static constexpr const char * config = ...;
+ *   // Entry of config listing the markers, e.g. "markers"
+ *   static constexpr const char * markers = ...;
+ *   // Prefix of the datastore entries, e.g. "WhyconPlugin"
+ *   static constexpr const char * datastore = ...;
+ *   // Load the description of a marker (name and robot are already set)
+ *   static void load(const mc_rtc::Configuration & config, Descriptor & marker);
+ *   // Topics subscribed by a camera given its topic entry
+ *   static std::vector<std::string> topics(const std::string & topic, const std::vector<Descriptor> & markers);
+ *   // Decode a message received on topics[topic], calls measurement(marker index, X_camera_marker) for every
+ *   // tracked marker, index(name) returns the index of a marker or npos
+ *   template<typename Index, typename Measurement>
+ *   static void decode(const Message & msg, size_t topic, Index && index, Measurement && measurement);
+ *   // Update policy: world position of a marker measured in a camera
+ *   static sva::PTransformd world(const Descriptor & marker,
+ *                                 const sva::PTransformd & X_camera_marker,
+ *                                 const sva::PTransformd & X_0_camera);
+ * };
+ * \endcode
+ *
+ * The member functions are defined in src/MarkerSubscriber.hpp and
+ * explicitly instantiated for every detector.
+ */
+template<typename Traits>
+struct MarkerSubscriber : public VisionSubscriber
+{
+  /** Returned by index() for markers that are not tracked */
+  static constexpr size_t npos = MeasurementSink::npos;
+
+  using Message = typename Traits::Message;
+  using Descriptor = typename Traits::Descriptor;
+
+  MarkerSubscriber(mc_control::MCController & controller, const mc_rtc::Configuration & config);
+
+  ~MarkerSubscriber();
+
+  MarkerSubscriber(const MarkerSubscriber &) = delete;
+  MarkerSubscriber(MarkerSubscriber &&) = delete;
+  MarkerSubscriber & operator=(const MarkerSubscriber &) = delete;
+  MarkerSubscriber & operator=(MarkerSubscriber &&) = delete;
+
+  /** Number of cameras, valid camera indices are in [0, cameras()) */
+  inline size_t cameras() const noexcept
+  {
+    return cameras_.size();
+  }
+
+  /** Description of a camera, the offset can be modified at runtime */
+  inline CameraDescriptor & camera(size_t camera)
+  {
+    return cameras_[camera]->descriptor;
+  }
+
+  inline const CameraDescriptor & camera(size_t camera) const
+  {
+    return cameras_[camera]->descriptor;
+  }
+
+  /** set the pose of a camera, to be called for every camera before tick()
+   *
+   * The pose is stamped with the current time and stored in the camera pose
+   * history used to compose the measurements at their capture time. It is
+   * ignored if the measurement source provides the camera poses (replay).
+   */
+  void cameraPose(size_t camera, const sva::PTransformd & pose);
+
+  /** Set the pose of the first camera */
+  inline void cameraPose(const sva::PTransformd & pose)
+  {
+    cameraPose(0, pose);
+  }
+
+  /** Current time of the clock used to stamp measurements and camera poses [s]
+   *
+   * This is the ROS time for the ros source, the time accumulated by tick()
+   * for the none, replay and lockstep simulation sources (starting from the
+   * first recorded time when replaying) and the system time otherwise (see
+   * SharedMemoryRing::now())
+   */
+  double now() const;
+
+  void tick(double dt) override;
+
+  /** Index of the marker with the given name, npos if it is not tracked */
+  size_t index(const std::string & name) const;
+
+  /** Integrate a message seen by a camera
+   *
+   * This is the subscription callback, it can also be called directly to feed
+   * the subscriber when <config>/source is none. For a given camera it must
+   * only be called from a single (vision) thread, different cameras can be fed
+   * concurrently.
+   *
+   * \param msg Message, decoded by Traits::decode
+   *
+   * \param camera Camera that produced the message
+   *
+   * \param topic Index of the topic on which the message was received in Traits::topics()
+   */
+  void process(const Message & msg, size_t camera = 0, size_t topic = 0);
+
+  /** Timing statistics of the plugin, displayed in Plugins/<name>/Timing */
+  inline Instrumentation & instrumentation() noexcept
+  {
+    return instrumentation_;
+  }
+
+  /** True if the subscriber tracks a marker with the given name */
+  inline bool hasMarker(const std::string & name) const
+  {
+    return indices_.count(name) != 0;
+  }
+
+  /** Resolve a marker name into a handle
+   *
+   * This should be done once at configuration time, the handle-based accessors
+   * do not perform any lookup.
+   *
+   * \throws If no marker with this name is tracked
+   */
+  MarkerHandle handle(const std::string & name) const;
+
+  /** Name of the marker referenced by the handle */
+  inline const std::string & name(MarkerHandle marker) const
+  {
+    return markers_[marker.index].name;
+  }
+
+  /** Static description of the marker referenced by the handle */
+  inline const Descriptor & descriptor(MarkerHandle marker) const
+  {
+    return markers_[marker.index];
+  }
+
+  /** Number of tracked markers, valid handles are in [0, size()) */
+  inline size_t size() const noexcept
+  {
+    return markers_.size();
+  }
+
+  /** Check whether a marker is visible or not */
+  bool visible(const std::string & marker) const;
+
+  inline bool visible(MarkerHandle marker) const
+  {
+    return states_.visible[marker.index];
+  }
+
+  /** Confidence in the last update of a marker, in [0, 1]
+   *
+   * It decreases as the next update is overdue with respect to the rate at
+   * which the marker is usually seen and as the marker may have moved since
+   * its last update. The marker is visible while the confidence is above the
+   * threshold configured in <config>/visibility or
+   * <config>/<markers>/<name>/visibility.
+   *
+   * Returns 0 for markers that are not tracked.
+   */
+  double confidence(const std::string & marker) const;
+
+  inline double confidence(MarkerHandle marker) const
+  {
+    return states_.confidence[marker.index];
+  }
+
+  /** Returns the camera position of a given marker
+   *
+   * With several cameras this is the position in the camera that provided the
+   * most confident observation during the last update, see camera(MarkerHandle).
+   * Two markers may then be expressed in different cameras: use commonCamera()
+   * to compute their relative position.
+   */
+  const sva::PTransformd & X_camera_marker(const std::string & marker) const;
+
+  inline const sva::PTransformd & X_camera_marker(MarkerHandle marker) const
+  {
+    return states_.pos[marker.index];
+  }
+
+  /** Index of the camera in which X_camera_marker() is expressed */
+  inline size_t camera(MarkerHandle marker) const
+  {
+    return states_.camera[marker.index];
+  }
+
+  /** Camera that currently sees both markers, npos if there is none
+   *
+   * Both markers must be visible and the camera must have an accepted
+   * observation of each of them within the fusion window of their last
+   * update. Among those cameras, the one whose observations are the most
+   * recent is returned. With a single camera this is 0 whenever both markers
+   * are visible.
+   */
+  size_t commonCamera(MarkerHandle a, MarkerHandle b) const;
+
+  /** Last position of a marker in a given camera, see commonCamera() */
+  inline const sva::PTransformd & X_camera_marker(MarkerHandle marker, size_t camera) const
+  {
+    return cameras_[camera]->states.pos[marker.index];
+  }
+
+  /** Returns the world position of a given marker */
+  const sva::PTransformd & X_0_marker(const std::string & marker) const;
+
+  inline const sva::PTransformd & X_0_marker(MarkerHandle marker) const
+  {
+    return states_.posW[marker.index];
+  }
+
+  /** Filtered pose, velocity and covariance of a marker
+   *
+   * The filter is configured globally in <config>/filter and per marker in
+   * <config>/<markers>/<name>/filter, by default the estimate follows the
+   * measurements
+   */
+  inline const MarkerEstimate & estimate(MarkerHandle marker) const
+  {
+    return filters_[marker.index].estimate();
+  }
+
+  /** Filter of a marker, see estimate() */
+  inline const MarkerFilter & filter(MarkerHandle marker) const
+  {
+    return filters_[marker.index];
+  }
+
+  /** Outlier rejection of a marker and its counters
+   *
+   * The gate is configured globally in <config>/gating and per marker in
+   * <config>/<markers>/<name>/gating
+   */
+  inline const MarkerGate & gate(MarkerHandle marker) const
+  {
+    return gates_[marker.index];
+  }
+
+  /** Sequence number of the last update of a marker
+   *
+   * It increases every time tick() integrates a new measurement of the marker
+   * and is 0 until the first one
+   */
+  inline uint64_t seq(MarkerHandle marker) const
+  {
+    return states_.count[marker.index];
+  }
+
+  /** Capture time of the last measurement of a marker [s] */
+  inline double stamp(MarkerHandle marker) const
+  {
+    return states_.stamp[marker.index];
+  }
+
+  /** True if the marker was updated after the sample lastSeq
+   *
+   * Keep seq() along with the results computed from a marker to skip the
+   * computation until a new measurement arrives (the camera rate is usually
+   * much lower than the control rate)
+   */
+  inline bool hasNewSample(MarkerHandle marker, uint64_t lastSeq) const
+  {
+    return states_.count[marker.index] != lastSeq;
+  }
+
+  /** Delay between the capture of the last measurement of a marker and its reception [s] */
+  inline double latency(MarkerHandle marker) const
+  {
+    return states_.latency[marker.index];
+  }
+
+  /** View of a marker, see MarkerView
+   *
+   * Unlike lshape() nothing is copied, prefer it in the control loop
+   */
+  inline MarkerView view(MarkerHandle marker) const
+  {
+    return {markers_[marker.index], states_, marker.index};
+  }
+
+  inline MarkerView view(const std::string & name) const
+  {
+    return view(handle(name));
+  }
+
+  /** Copy of the description and state of a marker, see view() */
+  const LShape lshape(const std::string & name) const
+  {
+    return lshape(handle(name));
+  }
+
+  /** Copy of the description and state of a marker, see view() */
+  const LShape lshape(MarkerHandle marker) const
+  {
+    const auto i = marker.index;
+    return {markers_[i], states_.visible[i] != 0, states_.confidence[i], states_.pos[i], states_.posW[i],
+            states_.lastUpdate[i]};
+  }
+
+private:
+  /** A camera and the channel carrying its measurements to the control thread
+   *
+   * The measurements are written by the thread of the source and published
+   * through a triple buffer, the rest is only accessed by the control thread
+   * (except the statistics).
+   */
+  struct Camera : public MeasurementSink
+  {
+    Camera(MarkerSubscriber & subscriber, size_t id, const CameraDescriptor & descriptor, size_t history);
+
+    double now() const override
+    {
+      return subscriber.now();
+    }
+
+    size_t index(const std::string & name) const override
+    {
+      return subscriber.index(name);
+    }
+
+    void measurement(size_t marker, const sva::PTransformd & X_camera_marker, double stamp, double received) override;
+
+    void publish() override;
+
+    void camera(double t, const sva::PTransformd & X_0_camera) override;
+
+    MarkerSubscriber & subscriber;
+    /** Index of the camera in the subscriber */
+    size_t id;
+    CameraDescriptor descriptor;
+    /** Poses of the camera during the last control iterations */
+    CameraPoseHistory history;
+    /** Measurements being gathered by the vision thread */
+    MarkerMeasurements pending;
+    /** Handoff of the measurements from the vision thread to the control thread */
+    TripleBuffer<MarkerMeasurements> measurements;
+    /** Markers state as seen by this camera */
+    MarkerStates states;
+    /** Non-zero if the last measurement of a marker was rejected by its gate */
+    aligned_vector<uint8_t> rejected;
+    /** Producer of the measurements, nullptr when they are provided through process() */
+    MeasurementSourcePtr source;
+    /** Duration of the message callback */
+    LatencyHistogram * callbackTiming = nullptr;
+    /** Keep only the newest message (queue of size 1) instead of processing every queued message */
+    bool latestOnly = true;
+    /** Message accounting, written by the vision thread (except conflated) */
+    struct
+    {
+      /** Messages processed by the callback */
+      std::atomic<uint64_t> processed{0};
+      /** Messages lost before reaching the callback (sequence gaps) or discarded as out-of-order */
+      std::atomic<uint64_t> dropped{0};
+      /** Measurements superseded before being consumed by the control thread */
+      uint64_t conflated = 0;
+    } ingestion;
+    /** State of each subscribed topic, only accessed by the vision thread */
+    struct Topic
+    {
+      /** Sequence number of the last processed message */
+      uint32_t lastSeq = 0;
+      /** Capture time of the last processed message */
+      double lastStamp = 0;
+    };
+    std::vector<Topic> topics;
+    /** Delay between the capture of a message and the start of its processing [s] */
+    struct
+    {
+      std::atomic<double> last{0};
+      std::atomic<double> average{0};
+      std::atomic<double> max{0};
+    } callbackLatency;
+  };
+
+  /** Name of the measurement source (<config>/source) */
+  std::string sourceName_;
+  /** Clock advanced by tick() (none, replay and lockstep simulation sources) */
+  bool external_ = false;
+  /** Clock used when external_ is true, advanced by tick() [s] */
+  std::atomic<double> time_{0};
+  std::shared_ptr<ros::NodeHandle> nh_;
+  mc_control::MCController & ctl_;
+  Instrumentation instrumentation_;
+  /** Duration of tick() */
+  LatencyHistogram * tickTiming_;
+  /** Age of the measurements when they are consumed by tick() */
+  LatencyHistogram * sampleAge_;
+  /** Index of each marker in the storage, immutable after construction */
+  std::unordered_map<std::string, size_t> indices_;
+  /** Static description of each marker (cold data) */
+  std::vector<Descriptor> markers_;
+  /** Markers state as seen by the control thread (hot data), fused from every camera */
+  MarkerStates states_;
+  /** Per-marker estimators, run by the control thread */
+  aligned_vector<MarkerFilter> filters_;
+  /** Per-marker outlier rejection, run by the control thread before the fusion */
+  aligned_vector<MarkerGate> gates_;
+  /** Per-marker confidence in the last update */
+  MarkerVisibility visibility_;
+  /** Cameras observing the markers */
+  std::vector<std::unique_ptr<Camera>> cameras_;
+  /** Combines the observations of the cameras */
+  MarkerFusion fusion_;
+  /** Observations of the marker being fused, one per camera at most */
+  std::vector<MarkerObservation> observations_;
+  /** Records the measurements and camera poses if <config>/record is set */
+  std::unique_ptr<MarkerRecorder> recorder_;
+  /** Samples and estimates published in the datastore, the entries are created
+   * by the constructor and removed by the destructor */
+  std::vector<MarkerSample *> samples_;
+  std::vector<MarkerEstimate *> estimates_;
+  /** False until the log and GUI entries of the markers are created */
+  bool registered_ = false;
+  /** Log and GUI entries of a marker, created on the first tick() */
+  void newMarker(MarkerHandle marker);
+  /** Gate then fuse the states of every camera into states_
+   *
+   * \param t Current time
+   */
+  void fuse(double t);
+};
+
+} // namespace whycon_plugin
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "LShape.h"
+#include "MarkerStorage.h"
+
+#include <mc_rtc/Configuration.h>
+
+#include <Eigen/Core>
+
+namespace whycon_plugin
+{
+
+/** Configuration of the visibility of a marker
+ *
+ * \code{.yaml}
+ * visibility:
+ *   # false: the marker is visible for timeout seconds after each update
+ *   adaptive: false
+ *   # A marker that has not been updated for this long is never visible [s]
+ *   timeout: 0.5
+ *   # Tolerated delay of the next update, in standard deviations of the
+ *   # inter-arrival time (the deviation is at least half the mean interval)
+ *   lateness: 4.0
+ *   # Tolerated motion of the marker since its next update was expected [m]
+ *   tolerance: 0.02
+ *   # Gain of the running averages of the inter-arrival time and speed
+ *   smoothing: 0.1
+ *   # The marker is visible while its confidence is above this threshold
+ *   threshold: 0.5
+ * \endcode
+ */
+struct MarkerVisibilityConfig
+{
+  bool adaptive = false;
+  double timeout = LSHAPE_VISIBILITY_TIMEOUT;
+  double lateness = 4.0;
+  double tolerance = 0.02;
+  double smoothing = 0.1;
+  double threshold = 0.5;
+
+  /** Load the configuration, entries that are not present keep their current value */
+  void load(const mc_rtc::Configuration & config);
+};
+
+/** Confidence in the last update of every marker
+ *
+ * The confidence combines two terms:
+ * - arrival: how late the next update is with respect to the inter-arrival
+ *   time statistics of this marker, a marker seen at a high rate becomes
+ *   stale sooner than a marker seen at a low rate
+ * - motion: how far the marker may have moved since its next update was
+ *   expected given its estimated speed, a static marker stays confident
+ *   longer. Markers updated on time are not penalized, however fast they move
+ *
+ * Until a few updates have been observed (or if adaptive is false) the
+ * confidence is 1 up to the timeout. It is always 0 past the timeout.
+ *
+ * Stored as a structure of arrays indexed by MarkerHandle::index
+ */
+struct MarkerVisibility
+{
+  /** Add a marker */
+  void add(const MarkerVisibilityConfig & config);
+
+  inline size_t size() const noexcept
+  {
+    return configs_.size();
+  }
+
+  inline const MarkerVisibilityConfig & config(size_t i) const noexcept
+  {
+    return configs_[i];
+  }
+
+  /** Update the statistics of a marker with a new measurement
+   *
+   * \param i Index of the marker
+   *
+   * \param stamp Capture time of the measurement [s]
+   *
+   * \param position World position of the marker
+   */
+  void observe(size_t i, double stamp, const Eigen::Vector3d & position);
+
+  /** Compute the confidence and visibility of every marker from the time since their last update */
+  void update(MarkerStates & states) const;
+
+  /** Mean interval between two updates of a marker [s] */
+  inline double interval(size_t i) const noexcept
+  {
+    return interval_[i];
+  }
+
+  /** Average speed of a marker [m/s] */
+  inline double speed(size_t i) const noexcept
+  {
+    return speed_[i];
+  }
+
+private:
+  aligned_vector<MarkerVisibilityConfig> configs_;
+  /** Number of intervals integrated in the statistics */
+  aligned_vector<uint64_t> samples_;
+  /** Running mean and variance of the inter-arrival time */
+  aligned_vector<double> interval_;
+  aligned_vector<double> intervalVariance_;
+  /** Running mean of the speed */
+  aligned_vector<double> speed_;
+  /** Capture time and position of the last measurement */
+  aligned_vector<double> lastStamp_;
+  aligned_vector<Eigen::Vector3d> lastPosition_;
+};
+
+} // namespace whycon_plugin
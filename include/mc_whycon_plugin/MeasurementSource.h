@@ -0,0 +1,92 @@
+#pragma once
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+#include <limits>
+#include <memory>
+#include <string>
+
+namespace whycon_plugin
+{
+
+/** Receiver of the measurements of a single camera
+ *
+ * The sink receives the measurements of its MeasurementSource through
+ * index(), measurement() and publish(), these are called from the thread of
+ * the source (or from tick() for sources running in lockstep with the
+ * controller).
+ */
+struct MeasurementSink
+{
+  /** Returned by index() for markers that are not tracked */
+  static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+  virtual ~MeasurementSink() = default;
+
+  /** Current time of the clock used to stamp measurements and camera poses [s] */
+  virtual double now() const = 0;
+
+  /** Index of the marker with the given name, npos if it is not tracked */
+  virtual size_t index(const std::string & name) const = 0;
+
+  /** Store a measurement of a marker, it becomes visible to the control thread on the next publish()
+   *
+   * \param marker Index of the marker
+   *
+   * \param X_camera_marker Position of the marker in the camera frame
+   *
+   * \param stamp Capture time [s]
+   *
+   * \param received Reception time [s]
+   */
+  virtual void measurement(size_t marker, const sva::PTransformd & X_camera_marker, double stamp, double received) = 0;
+
+  /** Hand the stored measurements over to the control thread */
+  virtual void publish() = 0;
+
+  /** Camera pose at time t, for sources providing the camera pose (e.g. replay)
+   *
+   * Must be called from the control thread
+   */
+  virtual void camera(double t, const sva::PTransformd & X_0_camera) = 0;
+};
+
+/** Producer of marker measurements (ROS topic, shared memory, replay, ...)
+ *
+ * A source feeds the MeasurementSink of one camera either from its own
+ * thread, started in start() and joined in stop(), or from tick() when it
+ * runs in lockstep with the controller.
+ */
+struct MeasurementSource
+{
+  virtual ~MeasurementSource() = default;
+
+  /** Start feeding the sink, called once the sink is fully constructed */
+  virtual void start(MeasurementSink & sink) = 0;
+
+  /** Stop feeding the sink, the sink must not be accessed after this returns */
+  virtual void stop() {}
+
+  /** Called by the control thread at every iteration, before the measurements are consumed
+   *
+   * \param t Current time of the sink clock
+   */
+  virtual void tick(double /* t */) {}
+
+  /** Called by the control thread with the camera pose at time t */
+  virtual void cameraPose(double /* t */, const sva::PTransformd & /* X_0_camera */) {}
+
+  /** True if the source provides the camera poses, in which case the poses
+   * computed by the controller are ignored */
+  virtual bool providesCameraPose() const
+  {
+    return false;
+  }
+
+  /** Short description of the source and its state, displayed in the GUI */
+  virtual std::string status() const = 0;
+};
+
+using MeasurementSourcePtr = std::unique_ptr<MeasurementSource>;
+
+} // namespace whycon_plugin
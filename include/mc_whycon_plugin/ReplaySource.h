@@ -0,0 +1,62 @@
+#pragma once
+
+#include "MarkerRecording.h"
+#include "MeasurementSource.h"
+
+#include <vector>
+
+namespace whycon_plugin
+{
+
+/** Replay a recording created by MarkerRecorder
+ *
+ * The records are fed from tick() up to the current time of the sink
+ * so the replay is deterministic and as fast as the controller is ticked. The
+ * recorded camera poses replace the ones computed by the controller.
+ *
+ * Each camera replays its own records, identified by the camera name.
+ */
+struct ReplaySource : public MeasurementSource
+{
+  /** Open the recording
+   *
+   * \param path Recording created by MarkerRecorder
+   *
+   * \param camera Name of the camera whose records are replayed, the only
+   * camera of the recording is used if no camera has this name
+   *
+   * \throws If the file is not a valid recording
+   */
+  ReplaySource(const std::string & path, const std::string & camera);
+
+  void start(MeasurementSink & sink) override;
+
+  void tick(double t) override;
+
+  bool providesCameraPose() const override
+  {
+    return true;
+  }
+
+  std::string status() const override
+  {
+    return replay_.done() ? "replay completed" : "replay";
+  }
+
+  /** Time of the first record [s] */
+  inline double startTime() const noexcept
+  {
+    return startTime_;
+  }
+
+private:
+  MarkerReplay replay_;
+  MeasurementSink * sink_ = nullptr;
+  /** Index in the sink of each marker of the recording (npos if not tracked) */
+  std::vector<size_t> indices_;
+  /** Index of the replayed camera in the recording, nothing is replayed if it is not in the recording */
+  size_t camera_ = 0;
+  double startTime_ = 0;
+};
+
+} // namespace whycon_plugin
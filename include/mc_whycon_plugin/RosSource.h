@@ -0,0 +1,174 @@
+#pragma once
+
+#include "MeasurementSource.h"
+
+#include <mc_rtc/logging.h>
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace whycon_plugin
+{
+
+/** Receive the measurements from one or several ROS topics
+ *
+ * Messages are served from a dedicated callback queue by a thread that blocks
+ * until a message is available, decoding the message is left to the callback.
+ *
+ * \tparam MsgT Message type
+ */
+template<typename MsgT>
+struct RosSource : public MeasurementSource
+{
+  using Callback = boost::function<void(const MsgT &)>;
+
+  /** Called with the message and the index of the topic it was received on */
+  using TopicCallback = boost::function<void(const MsgT &, size_t)>;
+
+  /** Constructor
+   *
+   * \param nh Node handle used to subscribe
+   *
+   * \param topic Topic to subscribe to
+   *
+   * \param queueSize Size of the subscription queue
+   *
+   * \param callback Called from the source thread for every message
+   */
+  RosSource(std::shared_ptr<ros::NodeHandle> nh, const std::string & topic, unsigned int queueSize, Callback callback)
+  : RosSource(nh, std::vector<std::string>{topic}, queueSize, [callback](const MsgT & msg, size_t) { callback(msg); })
+  {
+  }
+
+  /** Constructor
+   *
+   * \param nh Node handle used to subscribe
+   *
+   * \param topics Topics to subscribe to, all served by the same thread
+   *
+   * \param queueSize Size of each subscription queue
+   *
+   * \param callback Called from the source thread for every message
+   */
+  RosSource(std::shared_ptr<ros::NodeHandle> nh,
+            std::vector<std::string> topics,
+            unsigned int queueSize,
+            TopicCallback callback)
+  : nh_(nh), topics_(std::move(topics)), queueSize_(queueSize), callback_(callback), subs_(topics_.size()),
+    connected_(topics_.size(), 0)
+  {
+  }
+
+  ~RosSource() override
+  {
+    stop();
+  }
+
+  void start(MeasurementSink &) override
+  {
+    // Messages are processed from our own queue rather than the global one
+    ros::NodeHandle nh(*nh_);
+    nh.setCallbackQueue(&queue_);
+    for(size_t i = 0; i < topics_.size(); ++i)
+    {
+      try
+      {
+        subs_[i] = nh.subscribe<MsgT>(topics_[i], queueSize_,
+                                      boost::function<void(const MsgT &)>([this, i](const MsgT & msg)
+                                                                          { callback_(msg, i); }),
+                                      ros::VoidConstPtr(), ros::TransportHints().tcpNoDelay());
+      }
+      catch(...)
+      {
+        mc_rtc::log::warning("[WhyconPluginPlugin] Could not connect to topic {} (invalid name)", topics_[i]);
+      }
+    }
+    running_ = true;
+    // Block until a message is available and process it immediately
+    spinner_ = std::thread(
+        [this]()
+        {
+          while(running_ && ros::ok())
+          {
+            queue_.callAvailable(ros::WallDuration(0.1));
+          }
+        });
+  }
+
+  void stop() override
+  {
+    running_ = false;
+    if(spinner_.joinable())
+    {
+      spinner_.join();
+    }
+    for(auto & sub : subs_)
+    {
+      sub.shutdown();
+    }
+  }
+
+  void tick(double) override
+  {
+    for(size_t i = 0; i < subs_.size(); ++i)
+    {
+      if(subs_[i].getNumPublishers() > 0)
+      {
+        if(!connected_[i])
+        {
+          mc_rtc::log::success("[WhyconPluginPlugin] Connected to topic \"{}\"", topics_[i]);
+          connected_[i] = 1;
+        }
+      }
+      else
+      {
+        if(connected_[i])
+        {
+          mc_rtc::log::warning("[WhyconPluginPlugin] All publishers disconnected from topic \"{}\"", topics_[i]);
+          connected_[i] = 0;
+        }
+      }
+    }
+  }
+
+  std::string status() const override
+  {
+    if(topics_.size() == 1)
+    {
+      return (connected_[0] ? "connected to " : "disconnected from ") + topics_[0];
+    }
+    const auto connected = std::count(connected_.begin(), connected_.end(), 1);
+    return fmt::format("connected to {}/{} topics", connected, topics_.size());
+  }
+
+  /** First subscribed topic */
+  inline const std::string & topic() const noexcept
+  {
+    return topics_[0];
+  }
+
+  inline const std::vector<std::string> & topics() const noexcept
+  {
+    return topics_;
+  }
+
+private:
+  std::shared_ptr<ros::NodeHandle> nh_;
+  std::vector<std::string> topics_;
+  unsigned int queueSize_;
+  TopicCallback callback_;
+  std::vector<ros::Subscriber> subs_;
+  /** Queue dedicated to the subscriptions */
+  ros::CallbackQueue queue_;
+  /** Serve queue_ as soon as messages arrive */
+  std::thread spinner_;
+  std::atomic<bool> running_{false};
+  /** Updated by tick(), one entry per topic */
+  std::vector<uint8_t> connected_;
+};
+
+} // namespace whycon_plugin
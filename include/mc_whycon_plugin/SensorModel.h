@@ -0,0 +1,131 @@
+#pragma once
+
+#include <mc_rtc/Configuration.h>
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+#include <atomic>
+#include <random>
+#include <vector>
+
+namespace whycon_plugin
+{
+
+/** Configuration of a SensorModel
+ *
+ * Distances and poses are expressed in the camera optical frame (z forward,
+ * x right, y down). Every degradation is disabled by default.
+ *
+ * \code{.yaml}
+ * degradation:
+ *   # Seed of the random number generator
+ *   seed: 42
+ *   # Delay between the capture and the reception of a frame: fixed + uniform in [0, jitter] [s]
+ *   latency: 0.03
+ *   jitter: 0.01
+ *   # Standard deviation of the pose noise at the reference distance for a marker facing the camera
+ *   positionNoise: 0.001 # [m]
+ *   orientationNoise: 0.01 # [rad]
+ *   # The noise is scaled by (distance / referenceDistance)^distanceExponent
+ *   referenceDistance: 1.0 # [m]
+ *   distanceExponent: 2.0
+ *   # and by (1 + angleGain * (1 - cos(viewing angle)))
+ *   angleGain: 2.0
+ *   # Probability for a marker to start a burst of missed detections on each frame
+ *   dropoutProbability: 0.01
+ *   # Mean duration of a burst (exponential distribution) [s]
+ *   dropoutDuration: 0.3
+ *   # Field of view (0 to disable), markers behind the camera are only hidden if one is set [deg]
+ *   horizontalFov: 60
+ *   verticalFov: 45
+ *   # Maximum detection distance (0 to disable) [m]
+ *   maxDistance: 3.0
+ *   # Markers seen with a larger angle between their normal and the line of sight are not
+ *   # detected (90 to disable) [deg]
+ *   maxViewingAngle: 75
+ * \endcode
+ */
+struct SensorModelConfig
+{
+  uint64_t seed = 42;
+  double latency = 0;
+  double jitter = 0;
+  double positionNoise = 0;
+  double orientationNoise = 0;
+  double referenceDistance = 1.0;
+  double distanceExponent = 2.0;
+  double angleGain = 0;
+  double dropoutProbability = 0;
+  double dropoutDuration = 0;
+  double horizontalFov = 0;
+  double verticalFov = 0;
+  double maxDistance = 0;
+  double maxViewingAngle = 90;
+
+  /** Load the configuration, entries that are not present keep their current value */
+  void load(const mc_rtc::Configuration & config);
+
+  /** Largest latency that can be drawn [s] */
+  inline double maxLatency() const noexcept
+  {
+    return latency + jitter;
+  }
+};
+
+/** Degrade perfect marker measurements to mimic a real camera
+ *
+ * The random number generator is seeded from the configuration: given the
+ * same sequence of calls, the same degraded measurements are produced.
+ */
+struct SensorModel
+{
+  SensorModel(const SensorModelConfig & config, size_t markers);
+
+  inline const SensorModelConfig & config() const noexcept
+  {
+    return config_;
+  }
+
+  /** Latency of a frame [s] */
+  double latency();
+
+  /** Observe a marker
+   *
+   * \param marker Index of the marker
+   *
+   * \param t Capture time [s]
+   *
+   * \param X_camera_marker True position of the marker in the camera frame,
+   * replaced by the noisy measurement
+   *
+   * \returns False if the marker is not detected (outside the field of view or dropped)
+   */
+  bool observe(size_t marker, double t, sva::PTransformd & X_camera_marker);
+
+  /** Number of detections lost to dropouts */
+  inline uint64_t dropped() const noexcept
+  {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  /** Number of detections lost because the marker was not in view */
+  inline uint64_t occluded() const noexcept
+  {
+    return occluded_.load(std::memory_order_relaxed);
+  }
+
+private:
+  SensorModelConfig config_;
+  std::mt19937_64 rng_;
+  std::normal_distribution<double> normal_{0.0, 1.0};
+  std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+  /** End of the current dropout burst of each marker */
+  std::vector<double> dropoutUntil_;
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> occluded_{0};
+
+  /** True if the marker is in the field of view, sets the cosine of the viewing angle */
+  bool inView(const sva::PTransformd & X_camera_marker, double & cosAngle) const;
+};
+
+} // namespace whycon_plugin
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <SpaceVecAlg/SpaceVecAlg>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace whycon_plugin
+{
+
+/** Layout of the shared memory ring buffer
+ *
+ * The segment starts with a Header followed by capacity Slot. The writer fills
+ * slot head % capacity then increments head, each slot is protected by a
+ * sequence lock so that the reader can detect slots overwritten while it was
+ * reading them.
+ */
+namespace shm
+{
+
+constexpr uint32_t Magic = 0x57485943; // WHYC
+constexpr uint32_t Version = 1;
+/** Maximum length of a marker name, including the terminating null character */
+constexpr size_t MaxName = 32;
+
+struct alignas(64) Header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  /** Identifies a writer instance, changes when the segment is re-created */
+  uint64_t session;
+  /** Number of slots written since the creation of the segment */
+  alignas(64) std::atomic<uint64_t> head;
+};
+
+struct alignas(64) Slot
+{
+  /** Odd while the slot is being written */
+  std::atomic<uint32_t> seq;
+  /** Position of the measurement in the stream */
+  uint64_t index;
+  char name[MaxName];
+  /** Capture time [s] */
+  double stamp;
+  /** Quaternion (w, x, y, z) and translation of the marker in the camera frame */
+  double pose[7];
+};
+
+/** A measurement read from the ring */
+struct Measurement
+{
+  char name[MaxName];
+  double stamp;
+  sva::PTransformd pose;
+};
+
+} // namespace shm
+
+/** Shared memory ring buffer of marker measurements
+ *
+ * There must be a single writer (the detector) and a single reader (the
+ * plugin). Neither side blocks: when the reader falls behind by more than
+ * capacity measurements the oldest ones are lost.
+ *
+ * The segment is created by the writer with SharedMemoryRing::create() and
+ * removed when the writer is destroyed. Measurements must be stamped with
+ * SharedMemoryRing::now() (system clock).
+ */
+struct SharedMemoryRing
+{
+  /** Create the segment (replacing any existing segment with the same name)
+   *
+   * \param name Name of the segment, e.g. /whycon
+   *
+   * \param capacity Number of measurements kept in the ring
+   *
+   * \throws If the segment cannot be created
+   */
+  static std::unique_ptr<SharedMemoryRing> create(const std::string & name, uint32_t capacity = 1024);
+
+  /** Open an existing segment, returns nullptr if it does not exist or is not valid */
+  static std::unique_ptr<SharedMemoryRing> open(const std::string & name);
+
+  ~SharedMemoryRing();
+
+  SharedMemoryRing(const SharedMemoryRing &) = delete;
+  SharedMemoryRing & operator=(const SharedMemoryRing &) = delete;
+
+  /** Write a measurement (writer only)
+   *
+   * \param marker Name of the marker, truncated to shm::MaxName - 1 characters
+   *
+   * \param stamp Capture time, see now() [s]
+   *
+   * \param X_camera_marker Position of the marker in the camera frame
+   */
+  void write(const std::string & marker, double stamp, const sva::PTransformd & X_camera_marker) noexcept;
+
+  /** Number of measurements written so far */
+  inline uint64_t head() const noexcept
+  {
+    return header_->head.load(std::memory_order_acquire);
+  }
+
+  /** Read the measurement at position idx in the stream (reader only)
+   *
+   * \returns False if the slot does not hold this measurement anymore (or not yet)
+   */
+  bool read(uint64_t idx, shm::Measurement & out) const noexcept;
+
+  inline uint32_t capacity() const noexcept
+  {
+    return capacity_;
+  }
+
+  inline uint64_t session() const noexcept
+  {
+    return header_->session;
+  }
+
+  inline const std::string & name() const noexcept
+  {
+    return name_;
+  }
+
+  /** Clock used to stamp the measurements [s] */
+  static double now() noexcept;
+
+private:
+  SharedMemoryRing(const std::string & name, void * data, size_t size, uint32_t capacity, bool owner);
+
+  std::string name_;
+  void * data_;
+  size_t size_;
+  /** Validated copy of the capacity, the shared header is not trusted after open() */
+  uint32_t capacity_;
+  /** True for the writer, the segment is unlinked on destruction */
+  bool owner_;
+  shm::Header * header_;
+  shm::Slot * slots_;
+};
+
+} // namespace whycon_plugin
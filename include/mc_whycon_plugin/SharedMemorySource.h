@@ -0,0 +1,57 @@
+#pragma once
+
+#include "MeasurementSource.h"
+#include "SharedMemoryRing.h"
+
+#include <atomic>
+#include <thread>
+
+namespace whycon_plugin
+{
+
+/** Read the measurements written by the detector in a SharedMemoryRing
+ *
+ * The ring is polled by a dedicated thread. The segment is (re-)opened
+ * whenever it appears or is re-created by the detector.
+ */
+struct SharedMemorySource : public MeasurementSource
+{
+  /** Constructor
+   *
+   * \param name Name of the shared memory segment
+   *
+   * \param poll Delay between two polls when no measurement is available [s]
+   */
+  SharedMemorySource(const std::string & name, double poll);
+
+  ~SharedMemorySource() override;
+
+  void start(MeasurementSink & sink) override;
+
+  void stop() override;
+
+  std::string status() const override;
+
+  /** Measurements received so far */
+  inline uint64_t received() const noexcept
+  {
+    return received_.load(std::memory_order_relaxed);
+  }
+
+  /** Measurements overwritten by the detector before they could be read */
+  inline uint64_t overruns() const noexcept
+  {
+    return overruns_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::string name_;
+  double poll_;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<bool> connected_{false};
+  std::atomic<uint64_t> received_{0};
+  std::atomic<uint64_t> overruns_{0};
+};
+
+} // namespace whycon_plugin
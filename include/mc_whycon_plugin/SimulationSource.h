@@ -0,0 +1,126 @@
+#pragma once
+
+#include "LShape.h"
+#include "MeasurementSource.h"
+#include "SensorModel.h"
+#include "TripleBuffer.h"
+
+#include <mc_control/mc_controller.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace whycon_plugin
+{
+
+/** Configuration of a SimulationSource
+ *
+ * \code{.yaml}
+ * simulation:
+ *   # Rate at which measurements are generated [Hz]
+ *   rate: 30
+ *   # true: measurements are generated by tick(), runs are deterministic
+ *   # false: measurements are generated by a separate thread
+ *   lockstep: true
+ *   # Optional: degrade the measurements, see SensorModelConfig
+ *   degradation: {}
+ * \endcode
+ */
+struct SimulationConfig
+{
+  double rate = 30.0;
+  bool lockstep = true;
+  SensorModelConfig degradation;
+
+  /** Load the configuration, entries that are not present keep their current value */
+  void load(const mc_rtc::Configuration & config);
+};
+
+/** Generate the measurements from the position of the marker frames on the robots
+ *
+ * The robots are only accessed by the control thread: tick() takes a snapshot
+ * of the marker and camera poses. In lockstep mode the measurements are
+ * generated from this snapshot by tick() whenever a sampling period has
+ * elapsed on the sink clock. Otherwise a separate thread generates them
+ * at the configured rate from the latest snapshot.
+ *
+ * The measurements are degraded by a SensorModel then delivered in order once
+ * their latency has elapsed.
+ */
+struct SimulationSource : public MeasurementSource
+{
+  /** Constructor
+   *
+   * \param ctl Controller owning the robots
+   *
+   * \param markers Description of the markers
+   *
+   * \param config Rate and mode of the generator
+   */
+  SimulationSource(const mc_control::MCController & ctl,
+                   std::vector<MarkerDescriptor> markers,
+                   const SimulationConfig & config);
+
+  ~SimulationSource() override;
+
+  void start(MeasurementSink & sink) override;
+
+  void stop() override;
+
+  void tick(double t) override;
+
+  void cameraPose(double t, const sva::PTransformd & X_0_camera) override;
+
+  std::string status() const override;
+
+private:
+  /** Poses of the camera and markers at a given time */
+  struct Snapshot
+  {
+    double t = 0;
+    sva::PTransformd X_0_camera = sva::PTransformd::Identity();
+    std::vector<sva::PTransformd> X_0_markers;
+  };
+
+  const mc_control::MCController & ctl_;
+  std::vector<MarkerDescriptor> markers_;
+  SimulationConfig config_;
+  MeasurementSink * sink_ = nullptr;
+  /** Latest camera pose, only accessed by the control thread */
+  sva::PTransformd X_0_camera_ = sva::PTransformd::Identity();
+  /** Time of the next measurement (lockstep mode) */
+  double next_ = 0;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  /** Handoff of the snapshots from the control thread to the generator thread */
+  TripleBuffer<Snapshot> snapshots_;
+  /** Only used by the generating thread */
+  SensorModel model_;
+
+  /** Measurements captured at the same time, waiting for their delivery */
+  struct Frame
+  {
+    double stamp = 0;
+    double deliver = 0;
+    std::vector<uint8_t> detected;
+    std::vector<sva::PTransformd> X_camera_marker;
+  };
+  /** Ring of frames in delivery order */
+  std::vector<Frame> frames_;
+  /** Index of the oldest frame in frames_ */
+  size_t head_ = 0;
+  /** Number of frames waiting for their delivery */
+  size_t count_ = 0;
+
+  /** Observe the markers in a snapshot and queue the resulting frame */
+  void capture(const Snapshot & snapshot);
+
+  /** Deliver the frames whose latency elapsed at time t */
+  void deliver(double t);
+
+  /** Deliver the oldest frame */
+  void deliverOldest(double received);
+};
+
+} // namespace whycon_plugin
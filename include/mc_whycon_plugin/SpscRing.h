@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace whycon_plugin
+{
+
+/** Single-producer/single-consumer bounded queue
+ *
+ * The storage is allocated once by the constructor: push() and pop() never
+ * block nor allocate. When the queue is full push() fails and the value is
+ * counted as an overflow, the producer is never slowed down by the consumer.
+ */
+template<typename T>
+struct SpscRing
+{
+  /** Constructor
+   *
+   * \param capacity Maximum number of queued values, rounded up to a power of two
+   */
+  explicit SpscRing(size_t capacity)
+  {
+    size_t n = 1;
+    while(n < capacity)
+    {
+      n <<= 1;
+    }
+    buffer_.resize(n);
+    mask_ = n - 1;
+  }
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing & operator=(const SpscRing &) = delete;
+
+  /** Queue a value, called by the producer
+   *
+   * \returns False if the queue is full, the value is dropped
+   */
+  inline bool push(const T & value) noexcept
+  {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    if(tail - head_.load(std::memory_order_acquire) > mask_)
+    {
+      overflows_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    buffer_[tail & mask_] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** Dequeue the oldest value, called by the consumer
+   *
+   * \returns False if the queue is empty
+   */
+  inline bool pop(T & value) noexcept
+  {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if(head == tail_.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    value = buffer_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  inline size_t capacity() const noexcept
+  {
+    return buffer_.size();
+  }
+
+  /** Number of values dropped because the queue was full */
+  inline uint64_t overflows() const noexcept
+  {
+    return overflows_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<T> buffer_;
+  uint64_t mask_ = 0;
+  /** Index of the next value to pop, written by the consumer */
+  alignas(64) std::atomic<uint64_t> head_{0};
+  /** Index of the next value to push, written by the producer */
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  alignas(64) std::atomic<uint64_t> overflows_{0};
+};
+
+} // namespace whycon_plugin
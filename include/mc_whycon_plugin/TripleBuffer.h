@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace whycon_plugin
+{
+
+/** Single-producer/single-consumer triple buffer
+ *
+ * The producer owns one buffer to write into, the consumer owns one buffer to
+ * read from and the third buffer holds the latest published value. Both sides
+ * swap their buffer with the published one through a single atomic exchange:
+ * neither side ever blocks nor allocates, and the consumer always sees the
+ * latest complete value published by the producer.
+ *
+ * The producer must fully rewrite its buffer before each publish() since it
+ * gets back whatever buffer was previously published.
+ */
+template<typename T>
+struct TripleBuffer
+{
+  TripleBuffer() = default;
+
+  /** Initialize every buffer with the same value */
+  explicit TripleBuffer(const T & value)
+  {
+    reset(value);
+  }
+
+  /** Reset every buffer to the provided value, not thread-safe */
+  void reset(const T & value)
+  {
+    buffers_.fill(value);
+    front_ = 0;
+    middle_.store(1, std::memory_order_relaxed);
+    back_ = 2;
+  }
+
+  /** Buffer owned by the producer */
+  inline T & write() noexcept
+  {
+    return buffers_[back_];
+  }
+
+  /** Make the producer's buffer available to the consumer */
+  inline void publish() noexcept
+  {
+    back_ = middle_.exchange(back_ | dirty, std::memory_order_acq_rel) & mask;
+  }
+
+  /** Acquire the latest published buffer
+   *
+   * \returns True if a new value was published since the last call
+   */
+  inline bool update() noexcept
+  {
+    if(!(middle_.load(std::memory_order_relaxed) & dirty))
+    {
+      return false;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & mask;
+    return true;
+  }
+
+  /** Buffer owned by the consumer */
+  inline const T & read() const noexcept
+  {
+    return buffers_[front_];
+  }
+
+private:
+  static constexpr uint8_t mask = 3;
+  static constexpr uint8_t dirty = 4;
+
+  std::array<T, 3> buffers_;
+  /** Index of the consumer's buffer */
+  alignas(64) uint8_t front_ = 0;
+  /** Index of the published buffer and dirty flag */
+  alignas(64) std::atomic<uint8_t> middle_{1};
+  /** Index of the producer's buffer */
+  alignas(64) uint8_t back_ = 2;
+};
+
+} // namespace whycon_plugin
@@ -1,109 +1,103 @@
 #pragma once
 
-#include <sn_walking/Controller.h>
-#include <sn_walking/vision/VisionSubscriber.h>
+#include "MarkerSubscriber.h"
 
-#include <mc_rtc/Configuration.h>
-#include <mc_rtc/ros.h>
-#include <ros/ros.h>
+#include <mc_rbdyn/rpy_utils.h>
 
-#include <mutex>
-#include <thread>
+#include <geometry_msgs/PoseStamped.h>
 
-namespace sn_walking
+namespace whycon_plugin
 {
 
-namespace vision
+/** Represent an object tracked by the VISP detector */
+struct VISPObject : public MarkerDescriptor
 {
+  /** Offset applied to the estimated world position */
+  sva::PTransformd offset = sva::PTransformd::Identity();
+  /** Only keep the rotation about Z of the estimated world position */
+  bool yawOnly = false;
+  /** Topic on which the pose of the object is published */
+  std::string topic{};
+};
 
-/** Represent an object detected by the VISP detector */
-struct VISPObject
+/** VISP detector: every object is tracked on its own topic
+ *
+ * \code{.yaml}
+ * visp:
+ *   objects:
+ *     <name>:
+ *       # Robot carrying the object (default: main robot)
+ *       robot: box
+ *       # Frame of the object on the robot (used in simulation)
+ *       tf: Box
+ *       # Offset applied to the estimated world position
+ *       offset:
+ *         translation: [0, 0, 0]
+ *         rotation: [0, 0, 0]
+ *       # Only keep the yaw of the estimated orientation
+ *       yawOnly: false
+ *       # Topic publishing the object pose, relative to the camera topic if any
+ *       topic: <name>/pose_hand
+ * \endcode
+ */
+struct VISPTraits
 {
-  VISPObject(const std::string & name,
-             const std::string & robot,
-             const std::string & tf,
-             const sva::PTransformd & offset)
-  : name(name), robot(robot), tf(tf), offset(offset)
-  {
-  }
-
-  VISPObject() : name(""), robot(""), tf("") {}
+  using Message = geometry_msgs::PoseStamped;
+  using Descriptor = VISPObject;
 
-  /** Store object's name */
-  std::string name;
-  /** Store the robot linked to the object */
-  std::string robot;
-  /** Store the tf used in simulation to obtain a tf */
-  std::string tf;
-  /** Store world position */
-  sva::PTransformd posWorld;
-  /** Store simulation offset */
-  sva::PTransformd offset;
-  /** Only care about the rotation about Z for the reference simulation frame */
-  bool yawOnly = false;
+  static constexpr const char * name = "VISP";
+  static constexpr const char * config = "visp";
+  static constexpr const char * markers = "objects";
+  static constexpr const char * datastore = "VISPPlugin";
 
-  /** True if the object is visible */
-  bool visible = false;
-  /** Position of the l-shape in the camera frame */
-  sva::PTransformd pos = sva::PTransformd::Identity();
-  /** Position of the l-shape in the world frame (estimated) */
-  sva::PTransformd posW = sva::PTransformd::Identity();
-  /** Tick every iteration to update the visibility */
-  void tick(double dt)
+  static inline void load(const mc_rtc::Configuration & config, Descriptor & object)
   {
-    lastUpdate_ += dt;
-    visible = lastUpdate_ < 0.5;
+    object.frame = config("tf", std::string(""));
+    object.offset = config("offset", sva::PTransformd::Identity());
+    config("yawOnly", object.yawOnly);
+    object.topic = config("topic", object.name + "/pose_hand");
   }
-  /** Called to update the position of the object from the vision system */
-  void update(const sva::PTransformd & in, const sva::PTransformd & X_0_camera)
+
+  /** One topic per object, in the order of the objects */
+  static inline std::vector<std::string> topics(const std::string & topic, const std::vector<Descriptor> & objects)
   {
-    visible = true;
-    pos = in;
-    posW = offset * pos * X_0_camera;
-    lastUpdate_ = 0;
+    std::vector<std::string> out;
+    for(const auto & o : objects)
+    {
+      out.push_back(topic.empty() ? o.topic : topic + "/" + o.topic);
+    }
+    return out;
   }
 
-private:
-  double lastUpdate_ = 1;
-};
-
-/** Subscribe to VISP data to provide up-to-date information */
-struct VISPSubscriber : public VisionSubscriber
-{
-  VISPSubscriber(Controller & controller, const mc_rtc::Configuration & config);
-
-  ~VISPSubscriber();
-
-  VISPSubscriber(const VISPSubscriber &) = delete;
-  VISPSubscriber(VISPSubscriber &&) = delete;
-  VISPSubscriber & operator=(const VISPSubscriber &) = delete;
-  VISPSubscriber & operator=(VISPSubscriber &&) = delete;
-
-  void tick(double dt) override;
-
-  /** Check whether object is visible or not */
-  bool visible(const std::string & name) const;
-
-  const sva::PTransformd & X_camera_object(const std::string & object) const;
-
-  const sva::PTransformd & X_0_object(const std::string & object) const;
-
-  const VISPObject & object(const std::string & object) const
+  /** The topic identifies the object */
+  template<typename Index, typename Measurement>
+  static inline void decode(const Message & msg, size_t topic, Index &&, Measurement && measurement)
   {
-    return objects_.at(object);
+    const auto & pos = msg.pose.position;
+    const auto & rot = msg.pose.orientation;
+    const Eigen::Quaterniond q = Eigen::Quaterniond(rot.w, rot.x, rot.y, rot.z).inverse().normalized();
+    measurement(topic, sva::PTransformd{Eigen::Matrix3d(q), Eigen::Vector3d(pos.x, pos.y, pos.z)});
   }
 
-private:
-  bool running_ = true;
-  std::shared_ptr<ros::NodeHandle> nh_;
-  Controller & ctl_;
-  std::unordered_map<std::string, VISPObject> objects_;
-  std::thread updateThread_; // vector?
-  mutable std::mutex updateMutex_;
-  void newObject(const std::string & name);
-  std::vector<ros::Subscriber> subs_;
+  static inline sva::PTransformd world(const Descriptor & object,
+                                       const sva::PTransformd & X_camera_object,
+                                       const sva::PTransformd & X_0_camera)
+  {
+    sva::PTransformd X_0_object = X_camera_object * X_0_camera;
+    if(object.yawOnly)
+    {
+      X_0_object.rotation() = mc_rbdyn::rpyToMat(0, 0, mc_rbdyn::rpyFromMat(X_0_object.rotation()).z());
+    }
+    return object.offset * X_0_object;
+  }
 };
 
-} // namespace vision
+extern template struct MarkerSubscriber<VISPTraits>;
+
+/** Subscribe to VISP data to provide up-to-date information on the objects */
+struct VISPSubscriber : public MarkerSubscriber<VISPTraits>
+{
+  using MarkerSubscriber<VISPTraits>::MarkerSubscriber;
+};
 
-} // namespace sn_walking
+} // namespace whycon_plugin
@@ -9,6 +9,8 @@ namespace whycon_plugin
  * the manipulation phase */
 struct VisionSubscriber
 {
+  virtual ~VisionSubscriber() = default;
+
   /** Update vision system */
   virtual void tick(double dt) = 0;
 };
@@ -1,75 +1,79 @@
 #pragma once
 
-#include <mc_control/mc_controller.h>
-#include "LShape.h"
-#include "VisionSubscriber.h"
+#include "MarkerSubscriber.h"
 
-#include <mc_rtc/Configuration.h>
-#include <mc_rtc/ros.h>
-#include <ros/ros.h>
-
-#include <mutex>
-#include <thread>
+#include <whycon_lshape/WhyConLShapeMsg.h>
 
 namespace whycon_plugin
 {
 
-/** Subscribe to WhyCon data to provide up-to-date information on the markers */
-struct WhyConSubscriber : public VisionSubscriber
+/** WhyCon detector: every message carries all the l-shapes seen by a camera
+ *
+ * \code{.yaml}
+ * whycon:
+ *   markers:
+ *     <name>:
+ *       # Robot carrying the marker (default: main robot)
+ *       robot: box
+ *       # Frame of the robot the marker is attached to
+ *       relative: Box
+ *       # Position of the marker relative to this frame
+ *       pos:
+ *         translation: [0, 0, 0]
+ *         rotation: [0, 0, 0]
+ * \endcode
+ */
+struct WhyConTraits
 {
-  WhyConSubscriber(mc_control::MCController & controller, const mc_rtc::Configuration & config);
-
-  ~WhyConSubscriber();
+  using Message = whycon_lshape::WhyConLShapeMsg;
+  using Descriptor = MarkerDescriptor;
 
-  WhyConSubscriber(const WhyConSubscriber &) = delete;
-  WhyConSubscriber(WhyConSubscriber &&) = delete;
-  WhyConSubscriber & operator=(const WhyConSubscriber &) = delete;
-  WhyConSubscriber & operator=(WhyConSubscriber &&) = delete;
+  static constexpr const char * name = "WhyCon";
+  static constexpr const char * config = "whycon";
+  static constexpr const char * markers = "markers";
+  static constexpr const char * datastore = "WhyconPlugin";
 
-  /** set camera pose, to be called before tick() */
-  void cameraPose(const sva::PTransformd & pose)
+  static inline void load(const mc_rtc::Configuration & config, Descriptor & marker)
   {
-    X_0_camera = pose;
+    marker.frame = config("relative", std::string(""));
+    marker.frameOffset = config("pos", sva::PTransformd::Identity());
   }
 
-  void tick(double dt) override;
-
-  /** Check whether a marker is visible or not */
-  bool visible(const std::string & marker) const;
-
-  /** Returns the camera position of a given marker */
-  const sva::PTransformd & X_camera_marker(const std::string & marker) const;
-
-  /** Returns the world position of a given marker */
-  const sva::PTransformd & X_0_marker(const std::string & marker) const;
+  /** A single topic per camera */
+  static inline std::vector<std::string> topics(const std::string & topic, const std::vector<Descriptor> &)
+  {
+    return {topic};
+  }
 
-  const LShape lshape(const std::string & name) const
+  template<typename Index, typename Measurement>
+  static inline void decode(const Message & msg, size_t, Index && index, Measurement && measurement)
   {
-    if(lshapes_.count(name))
+    for(const auto & s : msg.shapes)
     {
-      return lshapes_.at(name);
-    }
-    else
-    {
-      mc_rtc::log::error_and_throw("[WhyconPlugin] No lshape named \"{}\"", name);
+      const auto i = index(s.name);
+      if(i != MeasurementSink::npos)
+      { // supported marker
+        Eigen::Vector3d pos{s.pose.position.x, s.pose.position.y, s.pose.position.z};
+        Eigen::Quaterniond q{s.pose.orientation.w, s.pose.orientation.x, s.pose.orientation.y, s.pose.orientation.z};
+        measurement(i, sva::PTransformd{q, pos});
+      }
     }
   }
 
-private:
-  bool simulation_ = false;
-  bool running_ = true;
-  std::shared_ptr<ros::NodeHandle> nh_;
-  mc_control::MCController & ctl_;
-  std::thread updateThread_;
-  mutable std::mutex updateMutex_;
-  std::unordered_map<std::string, LShape> readLshapes_;
-  std::unordered_map<std::string, LShape> lshapes_;
-  void newMarker(const std::string & name);
-  ros::Subscriber sub_;
-  bool connected_ = false;
-  std::string topic_ = "";
-  /* Store the world position of the camera */
-  sva::PTransformd X_0_camera = sva::PTransformd::Identity();
+  static inline sva::PTransformd world(const Descriptor &,
+                                       const sva::PTransformd & X_camera_marker,
+                                       const sva::PTransformd & X_0_camera)
+  {
+    return X_camera_marker * X_0_camera;
+  }
+};
+
+extern template struct MarkerSubscriber<WhyConTraits>;
+
+/** Subscribe to WhyCon data to provide up-to-date information on the markers */
+struct WhyConSubscriber : public MarkerSubscriber<WhyConTraits>
+{
+  using MarkerSubscriber<WhyConTraits>::MarkerSubscriber;
 };
 
 } // namespace whycon_plugin
@@ -24,16 +24,36 @@ struct WhyConUpdater : public TaskUpdater
                 const sva::PTransformd & frameOffset = sva::PTransformd::Identity()
                 );
 
-  /** Update a PBVS task based on the information provided by the WhyCon subscriber */
+  /** Create a task updater from already resolved marker handles
+   *
+   * \param subscriber WhyCon subscriber that will provide the data
+   * \param frame Handle of the frame marker
+   * \param env Handle of the environment marker
+   * \param envOffset Offset from the environment marker to the target object
+   * \param frameOffset Offset from the frame marker to the frame frame
+   */
+  WhyConUpdater(const WhyConSubscriber & subscriber,
+                MarkerHandle frame,
+                MarkerHandle env,
+                const sva::PTransformd & envOffset = sva::PTransformd::Identity(),
+                const sva::PTransformd & frameOffset = sva::PTransformd::Identity());
+
+  /** Update a PBVS task based on the information provided by the WhyCon subscriber
+   *
+   * Nothing is done if the task was already updated from the current samples
+   */
   bool update(mc_tasks::MetaTask & task) override;
 
-  /** Update look at task to look at the environment marker */
+  /** Update look at task to look at the environment marker
+   *
+   * Nothing is done if the task was already updated from the current samples
+   */
   bool updateLookAt(mc_tasks::LookAtTask & task) override;
 
-
   inline void envOffset(const sva::PTransformd & envOffset)
   {
     envOffset_ = envOffset;
+    task_.task = nullptr;
   }
 
   inline const sva::PTransformd & envOffset() const
@@ -44,6 +64,7 @@ struct WhyConUpdater : public TaskUpdater
   inline void frameOffset(const sva::PTransformd & frameOffset)
   {
     frameOffset_ = frameOffset;
+    task_.task = nullptr;
   }
 
   inline const sva::PTransformd & frameOffset() const
@@ -53,10 +74,22 @@ struct WhyConUpdater : public TaskUpdater
 
 private:
   const WhyConSubscriber & subscriber_;
-  std::string frame_;
-  std::string env_;
+  MarkerHandle frame_;
+  MarkerHandle env_;
   sva::PTransformd envOffset_;
   sva::PTransformd frameOffset_;
+  /** Task, samples and camera of the last successful update */
+  struct LastUpdate
+  {
+    const mc_tasks::MetaTask * task = nullptr;
+    uint64_t frame = 0;
+    uint64_t env = 0;
+    size_t camera = 0;
+  };
+  LastUpdate task_;
+  LastUpdate lookAt_;
+  /** True if task was last updated from the current samples seen by camera, records them otherwise */
+  bool upToDate(LastUpdate & last, const mc_tasks::MetaTask & task, size_t camera);
 };
 
 } // namespace whycon_plugin
@@ -8,13 +8,15 @@
 #include <mc_control/GlobalPluginMacros.h>
 #include <mc_rtc/DataStore.h>
 #include <mc_rtc/ros.h>
-#include <thread>
+#include <mc_tasks/LookAtTask.h>
 
 namespace whycon_plugin
 {
 
 struct WhyConSubscriber;
+struct VISPSubscriber;
 struct WhyConUpdater;
+struct LatencyHistogram;
 
 struct WhyconPlugin : public mc_control::GlobalPlugin
 {
@@ -30,18 +32,44 @@ struct WhyconPlugin : public mc_control::GlobalPlugin
   void after(mc_control::MCGlobalController & controller) override{};
 
 private:
-  std::shared_ptr<ros::NodeHandle> nh_;
+  /** A task updated by before() with its updater */
+  struct TaskBinding
+  {
+    /** Name of the updater */
+    std::string name;
+    WhyConUpdater * updater;
+    /** Exactly one of task and lookAt is set */
+    mc_tasks::MetaTask * task;
+    mc_tasks::LookAtTask * lookAt;
+    /** Result of the last update, stored in the datastore */
+    bool * updated;
+  };
+
+  /** Bind a task (or a look at task) to an updater, replaces the previous task of the same kind */
+  void bind(mc_control::MCController & ctl,
+            const std::string & name,
+            mc_tasks::MetaTask * task,
+            mc_tasks::LookAtTask * lookAt);
+
+  /** Remove all the bindings of an updater */
+  void unbind(mc_control::MCController & ctl, const std::string & name);
+
+  /** Update all bound tasks from the current markers estimate */
+  void updateTasks();
+
   std::shared_ptr<WhyConSubscriber> whyconSubscriber_;
+  /** Only created if the configuration has a visp entry */
+  std::shared_ptr<VISPSubscriber> vispSubscriber_;
   std::map<std::string, std::unique_ptr<WhyConUpdater>> taskUpdaters_;
+  /** Tasks updated in a single pass after the subscribers tick */
+  std::vector<TaskBinding> bindings_;
 
-  std::string cameraFrame_;
-  sva::PTransformd cameraOffset_;
+  /** Duration of before() */
+  LatencyHistogram * beforeTiming_ = nullptr;
 
   /* temporary hack. for now in mc_openrtm before() is called as soon as we do connectComponent, but
 init() is only called when starting the component */
   bool initialized_ = false;
-
-  std::thread spinner_;
 };
 
 } // namespace whycon_plugin
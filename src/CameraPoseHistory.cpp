@@ -0,0 +1,74 @@
+#include <mc_whycon_plugin/CameraPoseHistory.h>
+
+#include <algorithm>
+
+namespace whycon_plugin
+{
+
+CameraPoseHistory::CameraPoseHistory(size_t capacity)
+: stamps_(std::max<size_t>(capacity, 2), 0.0), poses_(std::max<size_t>(capacity, 2), sva::PTransformd::Identity())
+{
+}
+
+void CameraPoseHistory::push(double t, const sva::PTransformd & X_0_camera)
+{
+  if(size_ && t < newest())
+  {
+    clear();
+  }
+  stamps_[head_] = t;
+  poses_[head_] = X_0_camera;
+  head_ = (head_ + 1) % capacity();
+  size_ = std::min(size_ + 1, capacity());
+}
+
+double CameraPoseHistory::oldest() const noexcept
+{
+  return size_ ? stamps_[index(0)] : 0.0;
+}
+
+double CameraPoseHistory::newest() const noexcept
+{
+  return size_ ? stamps_[index(size_ - 1)] : 0.0;
+}
+
+sva::PTransformd CameraPoseHistory::at(double t) const
+{
+  if(size_ == 0)
+  {
+    return sva::PTransformd::Identity();
+  }
+  if(t <= oldest())
+  {
+    return poses_[index(0)];
+  }
+  if(t >= newest())
+  {
+    return poses_[index(size_ - 1)];
+  }
+  // Find the first sample newer than t
+  size_t lo = 0;
+  size_t hi = size_ - 1;
+  while(hi - lo > 1)
+  {
+    size_t mid = (lo + hi) / 2;
+    if(stamps_[index(mid)] <= t)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  const auto iLo = index(lo);
+  const auto iHi = index(hi);
+  const double dt = stamps_[iHi] - stamps_[iLo];
+  if(dt <= 0)
+  {
+    return poses_[iHi];
+  }
+  return sva::interpolate(poses_[iLo], poses_[iHi], (t - stamps_[iLo]) / dt);
+}
+
+} // namespace whycon_plugin
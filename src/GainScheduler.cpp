@@ -0,0 +1,109 @@
+#include <mc_whycon_plugin/GainScheduler.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace whycon_plugin
+{
+
+void GainSchedulerConfig::load(const mc_rtc::Configuration & config)
+{
+  if(config.has("type"))
+  {
+    std::string t = config("type");
+    if(t == "heuristic")
+    {
+      type = Type::Heuristic;
+    }
+    else if(t == "adaptive")
+    {
+      type = Type::Adaptive;
+    }
+    else
+    {
+      mc_rtc::log::error_and_throw("[GainScheduler] Unknown scheduler type {} (supported: heuristic, adaptive)", t);
+    }
+  }
+  config("period", period);
+  config("factor", factor);
+  config("timeConstant", timeConstant);
+  config("adaptationRate", adaptationRate);
+  config("smoothing", smoothing);
+  config("maxAge", maxAge);
+  if(factor < 1 || timeConstant <= 0 || adaptationRate < 0 || smoothing < 0)
+  {
+    mc_rtc::log::error_and_throw("[GainScheduler] factor must be at least 1, timeConstant strictly positive, "
+                                 "adaptationRate and smoothing positive");
+  }
+}
+
+double HeuristicGainScheduler::update(const GainSchedulerInput & input)
+{
+  if(input.speed < input.speedThreshold && iter_++ > config_.period)
+  {
+    const double k = std::min(config_.factor * k_, max_);
+    if(k_ < k)
+    {
+      k_ = k;
+      iter_ = 0;
+    }
+  }
+  return k_;
+}
+
+void HeuristicGainScheduler::reset()
+{
+  GainScheduler::reset();
+  iter_ = 0;
+}
+
+double AdaptiveGainScheduler::update(const GainSchedulerInput & input)
+{
+  const double dt = input.dt;
+  if(error_ < 0)
+  {
+    error_ = input.error;
+  }
+  const double alpha = dt / (config_.smoothing + dt);
+  rate_ += alpha * ((error_ - input.error) / dt - rate_);
+  error_ = input.error;
+  if(input.age > config_.maxAge)
+  { // Stale measurements: the error is not informative
+    k_ += std::min(1.0, config_.adaptationRate * dt) * (nominal_ - k_);
+  }
+  else
+  {
+    double target = input.error / config_.timeConstant;
+    if(input.maxSpeed > 0)
+    { // A saturated task cannot go faster whatever its stiffness
+      target = std::min(target, 0.9 * input.maxSpeed);
+    }
+    if(target > 0)
+    {
+      const double ratio = std::clamp(rate_ / target, 0.0, 2.0);
+      k_ *= std::exp(config_.adaptationRate * dt * (1 - ratio));
+    }
+  }
+  k_ = std::clamp(k_, nominal_, std::max(nominal_, max_));
+  return k_;
+}
+
+void AdaptiveGainScheduler::reset()
+{
+  GainScheduler::reset();
+  error_ = -1;
+  rate_ = 0;
+}
+
+std::unique_ptr<GainScheduler> makeGainScheduler(double stiffness,
+                                                 double maxStiffness,
+                                                 const GainSchedulerConfig & config)
+{
+  if(config.type == GainSchedulerConfig::Type::Adaptive)
+  {
+    return std::unique_ptr<GainScheduler>(new AdaptiveGainScheduler(stiffness, maxStiffness, config));
+  }
+  return std::unique_ptr<GainScheduler>(new HeuristicGainScheduler(stiffness, maxStiffness, config));
+}
+
+} // namespace whycon_plugin
@@ -0,0 +1,135 @@
+#include <mc_whycon_plugin/Instrumentation.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace whycon_plugin
+{
+
+void LatencyHistogram::record(double value) noexcept
+{
+  size_t bucket = 0;
+  if(value > MinValue)
+  {
+    bucket = std::min(static_cast<size_t>(BucketsPerOctave * std::log2(value / MinValue)), NBuckets - 1);
+  }
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  last_.store(value, std::memory_order_relaxed);
+  if(value > max_.load(std::memory_order_relaxed))
+  {
+    max_.store(value, std::memory_order_relaxed);
+  }
+}
+
+double LatencyHistogram::percentile(double p) const noexcept
+{
+  const uint64_t n = count();
+  if(n == 0)
+  {
+    return 0;
+  }
+  const auto target = static_cast<uint64_t>(std::ceil(p * static_cast<double>(n)));
+  uint64_t acc = 0;
+  for(size_t i = 0; i < NBuckets; ++i)
+  {
+    acc += buckets_[i].load(std::memory_order_relaxed);
+    if(acc >= target)
+    { // Geometric center of the bucket, capped by the observed maximum
+      const double center = MinValue * std::exp2((static_cast<double>(i) + 0.5) / BucketsPerOctave);
+      return std::min(center, max());
+    }
+  }
+  return max();
+}
+
+void LatencyHistogram::reset() noexcept
+{
+  for(auto & b : buckets_)
+  {
+    b.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+  last_.store(0, std::memory_order_relaxed);
+}
+
+Instrumentation::Instrumentation(mc_control::MCController & ctl,
+                                 const std::vector<std::string> & category,
+                                 const std::string & logPrefix)
+: ctl_(ctl), category_(category), logPrefix_(logPrefix)
+{
+  auto gui = ctl_.gui();
+  if(gui)
+  {
+    gui->addElement(category_, mc_rtc::gui::Button("Reset timings", [this]() { reset(); }));
+  }
+}
+
+Instrumentation::~Instrumentation()
+{
+  auto gui = ctl_.gui();
+  if(gui)
+  {
+    gui->removeCategory(category_);
+  }
+  for(const auto & s : stages_)
+  {
+    const auto prefix = logPrefix_ + "_" + s.name;
+    ctl_.logger().removeLogEntry(prefix + "_p50");
+    ctl_.logger().removeLogEntry(prefix + "_p99");
+    ctl_.logger().removeLogEntry(prefix + "_max");
+  }
+}
+
+LatencyHistogram & Instrumentation::stage(const std::string & name)
+{
+  for(auto & s : stages_)
+  {
+    if(s.name == name)
+    {
+      return s.histogram;
+    }
+  }
+  stages_.emplace_back();
+  auto & s = stages_.back();
+  s.name = name;
+  s.iter = stages_.size() - 1;
+  const auto prefix = logPrefix_ + "_" + name;
+  ctl_.logger().addLogEntry(prefix + "_p50",
+                            [&s]()
+                            {
+                              if(s.iter++ % RefreshPeriod == 0)
+                              {
+                                s.p50 = s.histogram.percentile(0.5);
+                                s.p99 = s.histogram.percentile(0.99);
+                              }
+                              return s.p50;
+                            });
+  ctl_.logger().addLogEntry(prefix + "_p99", [&s]() { return s.p99; });
+  ctl_.logger().addLogEntry(prefix + "_max", [&s]() { return s.histogram.max(); });
+  auto gui = ctl_.gui();
+  if(gui)
+  {
+    gui->addElement(category_, mc_rtc::gui::Label(name + " p50/p99/max [us]",
+                                                  [&s]()
+                                                  {
+                                                    const auto & h = s.histogram;
+                                                    return fmt::format("{:.1f} / {:.1f} / {:.1f} ({} samples)",
+                                                                       1e6 * h.percentile(0.5),
+                                                                       1e6 * h.percentile(0.99), 1e6 * h.max(),
+                                                                       h.count());
+                                                  }));
+  }
+  return s.histogram;
+}
+
+void Instrumentation::reset()
+{
+  for(auto & s : stages_)
+  {
+    s.histogram.reset();
+  }
+}
+
+} // namespace whycon_plugin
@@ -6,12 +6,14 @@ namespace whycon_plugin
 void LShape::tick(double dt)
 {
   lastUpdate_ += dt;
-  visible = lastUpdate_ < 0.5;
+  visible = lastUpdate_ < LSHAPE_VISIBILITY_TIMEOUT;
+  confidence = visible ? 1.0 : 0.0;
 }
 
 void LShape::update(const sva::PTransformd & in, const sva::PTransformd & X_0_camera)
 {
   visible = true;
+  confidence = 1.0;
   pos = in;
   posW = pos * X_0_camera;
   lastUpdate_ = 0;
@@ -0,0 +1,182 @@
+#include <mc_whycon_plugin/MarkerFilter.h>
+
+#include <algorithm>
+
+namespace whycon_plugin
+{
+
+namespace
+{
+
+/** Exponential map of a rotation vector */
+Eigen::Matrix3d rotationExp(const Eigen::Vector3d & w)
+{
+  const double angle = w.norm();
+  if(angle < 1e-12)
+  {
+    return Eigen::Matrix3d::Identity();
+  }
+  return Eigen::AngleAxisd(angle, w / angle).toRotationMatrix();
+}
+
+/** Logarithm map of a rotation matrix */
+Eigen::Vector3d rotationLog(const Eigen::Matrix3d & R)
+{
+  Eigen::AngleAxisd aa(R);
+  return aa.angle() * aa.axis();
+}
+
+/** Propagate the covariance of a constant-velocity model with white acceleration noise */
+void predictCovariance(Eigen::Matrix2d & P, double dt, double q)
+{
+  const double q2 = q * q;
+  const double dt2 = dt * dt;
+  P(0, 0) += dt * (2 * P(0, 1) + dt * P(1, 1)) + q2 * dt2 * dt2 / 4;
+  P(0, 1) += dt * P(1, 1) + q2 * dt2 * dt / 2;
+  P(1, 0) = P(0, 1);
+  P(1, 1) += q2 * dt2;
+}
+
+/** Kalman gain for a position measurement with noise r, updates the covariance */
+Eigen::Vector2d correctCovariance(Eigen::Matrix2d & P, double r)
+{
+  const double S = P(0, 0) + r * r;
+  Eigen::Vector2d K{P(0, 0) / S, P(1, 0) / S};
+  Eigen::Matrix2d Pn;
+  Pn(0, 0) = (1 - K(0)) * P(0, 0);
+  Pn(0, 1) = (1 - K(0)) * P(0, 1);
+  Pn(1, 0) = Pn(0, 1);
+  Pn(1, 1) = P(1, 1) - K(1) * P(0, 1);
+  P = Pn;
+  return K;
+}
+
+} // namespace
+
+void MarkerFilterConfig::load(const mc_rtc::Configuration & config)
+{
+  if(config.has("type"))
+  {
+    std::string t = config("type");
+    if(t == "none")
+    {
+      type = Type::None;
+    }
+    else if(t == "alphabeta")
+    {
+      type = Type::AlphaBeta;
+    }
+    else if(t == "kalman")
+    {
+      type = Type::Kalman;
+    }
+    else
+    {
+      mc_rtc::log::error_and_throw("[MarkerFilter] Unknown filter type {} (supported: none, alphabeta, kalman)", t);
+    }
+  }
+  config("alpha", alpha);
+  config("beta", beta);
+  config("positionNoise", positionNoise);
+  config("orientationNoise", orientationNoise);
+  config("linearAcceleration", linearAcceleration);
+  config("angularAcceleration", angularAcceleration);
+  config("timeout", timeout);
+}
+
+void MarkerFilter::predict(double dt)
+{
+  if(!initialized_)
+  {
+    return;
+  }
+  sinceCorrection_ += dt;
+  if(sinceCorrection_ > config_.timeout)
+  { // Do not extrapolate a marker that is no longer seen
+    return;
+  }
+  auto & v = estimate_.velocity;
+  estimate_.pose.translation() += dt * v.linear();
+  R_ = rotationExp(dt * v.angular()) * R_;
+  if(config_.type == MarkerFilterConfig::Type::Kalman)
+  {
+    predictCovariance(Plin_, dt, config_.linearAcceleration);
+    predictCovariance(Pang_, dt, config_.angularAcceleration);
+  }
+  updateEstimate();
+}
+
+void MarkerFilter::correct(const sva::PTransformd & X_0_marker, double age)
+{
+  if(!initialized_ || config_.type == MarkerFilterConfig::Type::None || sinceCorrection_ > config_.timeout)
+  {
+    reset(X_0_marker);
+    return;
+  }
+  auto & v = estimate_.velocity;
+  Eigen::Vector3d e_ang;
+  Eigen::Vector3d e_lin;
+  innovation(X_0_marker, age, e_ang, e_lin);
+
+  Eigen::Vector2d Klin;
+  Eigen::Vector2d Kang;
+  if(config_.type == MarkerFilterConfig::Type::Kalman)
+  {
+    Klin = correctCovariance(Plin_, config_.positionNoise);
+    Kang = correctCovariance(Pang_, config_.orientationNoise);
+  }
+  else
+  {
+    const double T = std::max(sinceCorrection_, 1e-3);
+    Klin << config_.alpha, config_.beta / T;
+    Kang = Klin;
+  }
+  estimate_.pose.translation() += Klin(0) * e_lin;
+  v.linear() += Klin(1) * e_lin;
+  R_ = rotationExp(Kang(0) * e_ang) * R_;
+  v.angular() += Kang(1) * e_ang;
+  sinceCorrection_ = 0;
+  updateEstimate();
+}
+
+bool MarkerFilter::innovation(const sva::PTransformd & X_0_marker,
+                              double age,
+                              Eigen::Vector3d & angular,
+                              Eigen::Vector3d & linear) const
+{
+  const auto & v = estimate_.velocity;
+  // Innovation at the capture time
+  const Eigen::Vector3d p_capture = estimate_.pose.translation() - age * v.linear();
+  const Eigen::Matrix3d R_capture = rotationExp(-age * v.angular()) * R_;
+  linear = X_0_marker.translation() - p_capture;
+  angular = rotationLog(X_0_marker.rotation().transpose() * R_capture.transpose());
+  return initialized_ && sinceCorrection_ <= config_.timeout;
+}
+
+void MarkerFilter::reset(const sva::PTransformd & X_0_marker)
+{
+  initialized_ = true;
+  sinceCorrection_ = 0;
+  R_ = X_0_marker.rotation().transpose();
+  estimate_.pose = X_0_marker;
+  estimate_.velocity = sva::MotionVecd(Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+  const double rl = config_.positionNoise;
+  const double ra = config_.orientationNoise;
+  // The initial velocity is unknown: one second of maximum acceleration
+  Plin_ << rl * rl, 0, 0, config_.linearAcceleration * config_.linearAcceleration;
+  Pang_ << ra * ra, 0, 0, config_.angularAcceleration * config_.angularAcceleration;
+  updateEstimate();
+}
+
+void MarkerFilter::updateEstimate()
+{
+  estimate_.pose.rotation() = R_.transpose();
+  if(config_.type == MarkerFilterConfig::Type::Kalman)
+  {
+    estimate_.covariance.diagonal() << Eigen::Vector3d::Constant(Pang_(0, 0)), Eigen::Vector3d::Constant(Plin_(0, 0));
+    estimate_.velocityCovariance.diagonal() << Eigen::Vector3d::Constant(Pang_(1, 1)),
+        Eigen::Vector3d::Constant(Plin_(1, 1));
+  }
+}
+
+} // namespace whycon_plugin
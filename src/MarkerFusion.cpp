@@ -0,0 +1,101 @@
+#include <mc_whycon_plugin/MarkerFusion.h>
+
+#include <mc_rtc/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace whycon_plugin
+{
+
+void MarkerFusionConfig::load(const mc_rtc::Configuration & config)
+{
+  config("positionNoise", positionNoise);
+  config("orientationNoise", orientationNoise);
+  config("distanceExponent", distanceExponent);
+  config("velocity", velocity);
+  config("angularVelocity", angularVelocity);
+  config("window", window);
+  if(positionNoise <= 0 || orientationNoise <= 0)
+  {
+    mc_rtc::log::error_and_throw("[MarkerFusion] positionNoise and orientationNoise must be strictly positive");
+  }
+}
+
+size_t MarkerFusion::fuse(const MarkerObservation * observations,
+                          size_t n,
+                          sva::PTransformd & X_0_marker,
+                          double & stamp) const
+{
+  stamp = -std::numeric_limits<double>::infinity();
+  for(size_t i = 0; i < n; ++i)
+  {
+    stamp = std::max(stamp, observations[i].stamp);
+  }
+  // Inverse of the position and orientation variances, 0 outside of the window
+  auto weights = [this, stamp](const MarkerObservation & o, double & wp, double & wr)
+  {
+    const double age = stamp - o.stamp;
+    if(age > config_.window)
+    {
+      wp = wr = 0;
+      return;
+    }
+    const double scale = std::pow(o.distance, config_.distanceExponent);
+    const double sp = config_.positionNoise * scale + age * config_.velocity;
+    const double sr = config_.orientationNoise * scale + age * config_.angularVelocity;
+    // Guard against markers at the camera origin
+    wp = 1.0 / std::max(sp * sp, 1e-12);
+    wr = 1.0 / std::max(sr * sr, 1e-12);
+  };
+  size_t best = 0;
+  double bestWeight = -1;
+  double sum = 0;
+  Eigen::Vector3d translation = Eigen::Vector3d::Zero();
+  for(size_t i = 0; i < n; ++i)
+  {
+    double wp = 0;
+    double wr = 0;
+    weights(observations[i], wp, wr);
+    translation += wp * observations[i].X_0_marker.translation();
+    sum += wp;
+    if(wp > bestWeight)
+    {
+      best = i;
+      bestWeight = wp;
+    }
+  }
+  const Eigen::Matrix3d & E0 = observations[best].X_0_marker.rotation();
+  if(n == 1 || sum == bestWeight)
+  { // Nothing to fuse
+    X_0_marker = observations[best].X_0_marker;
+    return best;
+  }
+  Eigen::Vector3d w = Eigen::Vector3d::Zero();
+  double wsum = 0;
+  for(size_t i = 0; i < n; ++i)
+  {
+    double wp = 0;
+    double wr = 0;
+    weights(observations[i], wp, wr);
+    if(wr == 0)
+    {
+      continue;
+    }
+    const Eigen::AngleAxisd delta(observations[i].X_0_marker.rotation() * E0.transpose());
+    w += wr * delta.angle() * delta.axis();
+    wsum += wr;
+  }
+  w /= wsum;
+  const double angle = w.norm();
+  X_0_marker.translation() = translation / sum;
+  X_0_marker.rotation() = E0;
+  if(angle > 1e-12)
+  {
+    X_0_marker.rotation() = Eigen::AngleAxisd(angle, w / angle).toRotationMatrix() * E0;
+  }
+  return best;
+}
+
+} // namespace whycon_plugin
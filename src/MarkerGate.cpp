@@ -0,0 +1,74 @@
+#include <mc_whycon_plugin/MarkerGate.h>
+
+#include <mc_rtc/constants.h>
+#include <mc_rtc/logging.h>
+
+namespace whycon_plugin
+{
+
+void MarkerGateConfig::load(const mc_rtc::Configuration & config)
+{
+  config("enabled", enabled);
+  config("threshold", threshold);
+  config("positionNoise", positionNoise);
+  config("orientationNoise", orientationNoise);
+  config("velocity", velocity);
+  config("angularVelocity", angularVelocity);
+  config("flipAngle", flipAngle);
+  config("maxRejections", maxRejections);
+  if(positionNoise <= 0 || orientationNoise <= 0)
+  {
+    mc_rtc::log::error_and_throw("[MarkerGate] positionNoise and orientationNoise must be strictly positive");
+  }
+}
+
+MarkerGate::Result MarkerGate::check(const MarkerFilter & filter, const sva::PTransformd & X_0_marker, double age)
+{
+  distance_ = 0;
+  Eigen::Vector3d e_ang;
+  Eigen::Vector3d e_lin;
+  if(!config_.enabled || !filter.innovation(X_0_marker, age, e_ang, e_lin))
+  { // Nothing to compare with
+    consecutive_ = 0;
+    return Result::Accepted;
+  }
+  // Per-axis variances, the filter covariance is isotropic (zero if it does not estimate it)
+  const auto & P = filter.estimate().covariance;
+  const double dt = filter.sinceCorrection();
+  const double motion = config_.velocity * dt;
+  const double angularMotion = config_.angularVelocity * dt;
+  const double s_lin = P(3, 3) + config_.positionNoise * config_.positionNoise + motion * motion;
+  const double s_ang = P(0, 0) + config_.orientationNoise * config_.orientationNoise + angularMotion * angularMotion;
+  distance_ = e_lin.squaredNorm() / s_lin + e_ang.squaredNorm() / s_ang;
+  Result result = Result::Accepted;
+  if(config_.flipAngle > 0 && e_ang.norm() > config_.flipAngle * mc_rtc::constants::PI / 180)
+  {
+    result = Result::Flip;
+  }
+  else if(config_.threshold > 0 && distance_ > config_.threshold)
+  {
+    result = Result::Outlier;
+  }
+  if(result == Result::Accepted)
+  {
+    consecutive_ = 0;
+    return result;
+  }
+  if(++consecutive_ > config_.maxRejections)
+  {
+    consecutive_ = 0;
+    recoveries_++;
+    return Result::Recovered;
+  }
+  if(result == Result::Flip)
+  {
+    flips_++;
+  }
+  else
+  {
+    outliers_++;
+  }
+  return result;
+}
+
+} // namespace whycon_plugin
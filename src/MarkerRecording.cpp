@@ -0,0 +1,284 @@
+#include <mc_whycon_plugin/MarkerRecording.h>
+
+#include <mc_rtc/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace whycon_plugin
+{
+
+namespace
+{
+
+template<typename T>
+void put(std::vector<char> & buffer, const T & value)
+{
+  const auto size = buffer.size();
+  buffer.resize(size + sizeof(T));
+  std::memcpy(buffer.data() + size, &value, sizeof(T));
+}
+
+void putPose(std::vector<char> & buffer, const sva::PTransformd & pose)
+{
+  const Eigen::Quaterniond q(pose.rotation());
+  const Eigen::Vector3d & t = pose.translation();
+  for(double v : {q.w(), q.x(), q.y(), q.z(), t.x(), t.y(), t.z()})
+  {
+    put(buffer, v);
+  }
+}
+
+template<typename T>
+bool get(std::ifstream & in, T & value)
+{
+  return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+bool getPose(std::ifstream & in, sva::PTransformd & pose)
+{
+  double v[7];
+  if(!in.read(reinterpret_cast<char *>(v), sizeof(v)))
+  {
+    return false;
+  }
+  pose = {Eigen::Quaterniond{v[0], v[1], v[2], v[3]}, Eigen::Vector3d{v[4], v[5], v[6]}};
+  return true;
+}
+
+void putNames(std::vector<char> & buffer, const std::vector<std::string> & names)
+{
+  put(buffer, static_cast<uint32_t>(names.size()));
+  for(const auto & n : names)
+  {
+    put(buffer, static_cast<uint32_t>(n.size()));
+    buffer.insert(buffer.end(), n.begin(), n.end());
+  }
+}
+
+bool getNames(std::ifstream & in, std::vector<std::string> & names)
+{
+  uint32_t n = 0;
+  if(!get(in, n))
+  {
+    return false;
+  }
+  names.resize(n);
+  for(auto & name : names)
+  {
+    uint32_t size = 0;
+    if(!get(in, size))
+    {
+      return false;
+    }
+    name.resize(size);
+    if(size != 0 && !in.read(&name[0], size))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+MarkerRecorder::MarkerRecorder(const std::string & path,
+                               const std::vector<std::string> & markers,
+                               const std::vector<std::string> & cameras,
+                               size_t capacity)
+: path_(path), out_(path, std::ios::binary | std::ios::trunc)
+{
+  if(!out_)
+  {
+    mc_rtc::log::error_and_throw("[MarkerRecorder] Cannot open {} for writing", path);
+  }
+  std::vector<char> header;
+  for(char c : recording::Magic)
+  {
+    put(header, c);
+  }
+  put(header, recording::Version);
+  putNames(header, markers);
+  putNames(header, cameras);
+  out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+  for(size_t i = 0; i < cameras.size(); ++i)
+  {
+    measurements_.emplace_back(new SpscRing<recording::Record>(capacity));
+    cameras_.emplace_back(new SpscRing<recording::Record>(capacity));
+  }
+  pending_.reserve(2 * cameras.size() * capacity);
+  writing_.reserve(1 << 16);
+  writer_ = std::thread(
+      [this]()
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(running_)
+        {
+          cv_.wait_for(lock, std::chrono::milliseconds(20), [this]() { return !running_; });
+          lock.unlock();
+          flush();
+          lock.lock();
+        }
+        lock.unlock();
+        // Records pushed before the destructor was called
+        flush();
+      });
+  mc_rtc::log::info("[MarkerRecorder] Recording markers to {}", path_);
+}
+
+MarkerRecorder::~MarkerRecorder()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  writer_.join();
+  out_.flush();
+  const auto dropped = overflows();
+  if(dropped != 0)
+  {
+    mc_rtc::log::warning("[MarkerRecorder] {} records could not be queued and are missing from {}", dropped, path_);
+  }
+}
+
+uint64_t MarkerRecorder::overflows() const noexcept
+{
+  uint64_t count = 0;
+  for(size_t i = 0; i < cameras_.size(); ++i)
+  {
+    count += measurements_[i]->overflows() + cameras_[i]->overflows();
+  }
+  return count;
+}
+
+void MarkerRecorder::camera(uint8_t camera, double t, const sva::PTransformd & X_0_camera)
+{
+  recording::Record record;
+  record.type = recording::RecordType::Camera;
+  record.camera = camera;
+  record.stamp = t;
+  record.received = t;
+  record.pose = X_0_camera;
+  cameras_[camera]->push(record);
+}
+
+void MarkerRecorder::measurement(uint8_t camera,
+                                 uint32_t marker,
+                                 double stamp,
+                                 double received,
+                                 const sva::PTransformd & X_camera_marker)
+{
+  recording::Record record;
+  record.type = recording::RecordType::Measurement;
+  record.camera = camera;
+  record.marker = marker;
+  record.stamp = stamp;
+  record.received = received;
+  record.pose = X_camera_marker;
+  measurements_[camera]->push(record);
+}
+
+void MarkerRecorder::flush()
+{
+  pending_.clear();
+  recording::Record record;
+  for(size_t i = 0; i < cameras_.size(); ++i)
+  {
+    while(measurements_[i]->pop(record))
+    {
+      pending_.push_back(record);
+    }
+    while(cameras_[i]->pop(record))
+    {
+      pending_.push_back(record);
+    }
+  }
+  if(pending_.empty())
+  {
+    return;
+  }
+  // Each queue is ordered, merge them so that the replay sees the records in the order they were received
+  std::stable_sort(pending_.begin(), pending_.end(),
+                   [](const recording::Record & a, const recording::Record & b) { return a.received < b.received; });
+  writing_.clear();
+  for(const auto & r : pending_)
+  {
+    put(writing_, r.type);
+    put(writing_, r.camera);
+    if(r.type == recording::RecordType::Camera)
+    {
+      put(writing_, r.stamp);
+    }
+    else
+    {
+      put(writing_, r.marker);
+      put(writing_, r.stamp);
+      put(writing_, r.received);
+    }
+    putPose(writing_, r.pose);
+  }
+  out_.write(writing_.data(), static_cast<std::streamsize>(writing_.size()));
+}
+
+MarkerReplay::MarkerReplay(const std::string & path) : path_(path), in_(path, std::ios::binary)
+{
+  if(!in_)
+  {
+    mc_rtc::log::error_and_throw("[MarkerReplay] Cannot open {}", path);
+  }
+  char magic[sizeof(recording::Magic)];
+  if(!in_.read(magic, sizeof(magic)) || std::memcmp(magic, recording::Magic, sizeof(magic)) != 0
+     || !get(in_, version_))
+  {
+    mc_rtc::log::error_and_throw("[MarkerReplay] {} is not a marker recording", path);
+  }
+  if(version_ != 1 && version_ != recording::Version)
+  {
+    mc_rtc::log::error_and_throw("[MarkerReplay] {} has version {}, only versions 1 to {} are supported", path,
+                                 version_, recording::Version);
+  }
+  bool ok = getNames(in_, markers_);
+  if(version_ == 1)
+  { // Single camera recordings
+    cameras_ = {"camera"};
+  }
+  else
+  {
+    ok = ok && getNames(in_, cameras_);
+  }
+  if(!ok)
+  {
+    mc_rtc::log::error_and_throw("[MarkerReplay] {} has a truncated header", path);
+  }
+  pop();
+}
+
+void MarkerReplay::pop()
+{
+  if(done_)
+  {
+    return;
+  }
+  auto & r = next_;
+  bool ok = get(in_, r.type) && (version_ == 1 || get(in_, r.camera));
+  if(ok && r.type == recording::RecordType::Camera)
+  {
+    ok = get(in_, r.stamp) && getPose(in_, r.pose);
+    r.received = r.stamp;
+  }
+  else if(ok && r.type == recording::RecordType::Measurement)
+  {
+    ok = get(in_, r.marker) && get(in_, r.stamp) && get(in_, r.received) && getPose(in_, r.pose);
+  }
+  else if(ok)
+  {
+    mc_rtc::log::error("[MarkerReplay] Unknown record type {} in {}, stopping the replay", static_cast<int>(r.type),
+                       path_);
+    ok = false;
+  }
+  done_ = !ok;
+}
+
+} // namespace whycon_plugin
@@ -0,0 +1,668 @@
+/** Definition of the MarkerSubscriber members
+ *
+ * Only included by the translation units that explicitly instantiate a
+ * MarkerSubscriber, see WhyConSubscriber.cpp and VISPSubscriber.cpp.
+ */
+
+#pragma once
+
+#include <mc_whycon_plugin/MarkerSubscriber.h>
+#include <mc_whycon_plugin/ReplaySource.h>
+#include <mc_whycon_plugin/RosSource.h>
+#include <mc_whycon_plugin/SharedMemorySource.h>
+#include <mc_whycon_plugin/SimulationSource.h>
+
+#include <ros/ros.h>
+#include <algorithm>
+#include <limits>
+
+namespace whycon_plugin
+{
+
+template<typename Traits>
+MarkerSubscriber<Traits>::Camera::Camera(MarkerSubscriber & subscriber,
+                                         size_t id,
+                                         const CameraDescriptor & descriptor,
+                                         size_t history)
+: subscriber(subscriber), id(id), descriptor(descriptor), history(history)
+{
+  const auto n = subscriber.markers_.size();
+  pending.resize(n);
+  measurements.reset(pending);
+  states.resize(n);
+  rejected.resize(n, 0);
+  topics.resize(std::max<size_t>(Traits::topics("", subscriber.markers_).size(), 1));
+  callbackTiming = &subscriber.instrumentation_.stage(std::string(Traits::name) + "Subscriber::callback_"
+                                                      + descriptor.name);
+}
+
+template<typename Traits>
+void MarkerSubscriber<Traits>::Camera::measurement(size_t i,
+                                                   const sva::PTransformd & X_camera_marker,
+                                                   double stamp,
+                                                   double received)
+{
+  pending.pos[i] = X_camera_marker;
+  pending.stamp[i] = stamp;
+  pending.received[i] = received;
+  pending.count[i]++;
+  if(subscriber.recorder_)
+  {
+    subscriber.recorder_->measurement(static_cast<uint8_t>(id), static_cast<uint32_t>(i), stamp, received,
+                                      X_camera_marker);
+  }
+}
+
+template<typename Traits>
+void MarkerSubscriber<Traits>::Camera::publish()
+{
+  measurements.write() = pending;
+  measurements.publish();
+}
+
+template<typename Traits>
+void MarkerSubscriber<Traits>::Camera::camera(double t, const sva::PTransformd & X_0_camera)
+{
+  if(subscriber.recorder_)
+  {
+    subscriber.recorder_->camera(static_cast<uint8_t>(id), t, X_0_camera);
+  }
+  history.push(t, X_0_camera);
+  if(source)
+  {
+    source->cameraPose(t, X_0_camera);
+  }
+}
+
+template<typename Traits>
+MarkerSubscriber<Traits>::MarkerSubscriber(mc_control::MCController & ctl, const mc_rtc::Configuration & config)
+: ctl_(ctl), instrumentation_(ctl, {"Plugins", Traits::name, "Timing"}, std::string(Traits::name) + "Timing")
+{
+  tickTiming_ = &instrumentation_.stage(std::string(Traits::name) + "Subscriber::tick");
+  sampleAge_ = &instrumentation_.stage("Sample age");
+  bool simulation = false;
+  ctl.config()("simulation", simulation);
+  auto methodConf = config(Traits::config);
+  sourceName_ = methodConf("source", std::string(simulation ? "simulation" : "ros"));
+  if(sourceName_ != "ros" && sourceName_ != "simulation" && sourceName_ != "shm" && sourceName_ != "replay"
+     && sourceName_ != "none")
+  {
+    mc_rtc::log::error_and_throw(
+        "[{}Subscriber] {}/source must be ros, simulation, shm, replay or none (got: {})", Traits::name,
+        Traits::config, sourceName_);
+  }
+  SimulationConfig simulationConfig;
+  if(sourceName_ == "simulation" && methodConf.has("simulation"))
+  {
+    simulationConfig.load(methodConf("simulation"));
+  }
+  external_ =
+      sourceName_ == "replay" || sourceName_ == "none" || (sourceName_ == "simulation" && simulationConfig.lockstep);
+  if(sourceName_ == "ros")
+  {
+    nh_ = mc_rtc::ROSBridge::get_node_handle();
+    if(!nh_)
+    {
+      mc_rtc::log::error_and_throw("[{}Subscriber] ROS is not available", Traits::name);
+    }
+  }
+
+  MarkerFilterConfig filterConfig;
+  if(methodConf.has("filter"))
+  {
+    filterConfig.load(methodConf("filter"));
+  }
+  MarkerGateConfig gateConfig;
+  if(methodConf.has("gating"))
+  {
+    gateConfig.load(methodConf("gating"));
+  }
+  MarkerVisibilityConfig visibilityConfig;
+  if(methodConf.has("visibility"))
+  {
+    visibilityConfig.load(methodConf("visibility"));
+  }
+  auto markers = methodConf(Traits::markers);
+  for(auto k : markers.keys())
+  {
+    Descriptor marker;
+    marker.name = k;
+    marker.robot = markers(k)("robot", ctl.robot().name());
+    Traits::load(markers(k), marker);
+    indices_[k] = markers_.size();
+    markers_.push_back(marker);
+    auto markerFilterConfig = filterConfig;
+    if(markers(k).has("filter"))
+    {
+      markerFilterConfig.load(markers(k)("filter"));
+    }
+    filters_.emplace_back(markerFilterConfig);
+    auto markerGateConfig = gateConfig;
+    if(markers(k).has("gating"))
+    {
+      markerGateConfig.load(markers(k)("gating"));
+    }
+    gates_.emplace_back(markerGateConfig);
+    auto markerVisibilityConfig = visibilityConfig;
+    if(markers(k).has("visibility"))
+    {
+      markerVisibilityConfig.load(markers(k)("visibility"));
+    }
+    visibility_.add(markerVisibilityConfig);
+  }
+  states_.resize(markers_.size());
+  for(const auto & m : markers_)
+  {
+    const std::string key = std::string(Traits::datastore) + "::Marker";
+    samples_.push_back(&ctl_.datastore().make<MarkerSample>(key + "::" + m.name));
+    estimates_.push_back(&ctl_.datastore().make<MarkerEstimate>(key + "Estimate::" + m.name));
+  }
+
+  MarkerFusionConfig fusionConfig;
+  if(methodConf.has("fusion"))
+  {
+    fusionConfig.load(methodConf("fusion"));
+  }
+  fusion_ = MarkerFusion(fusionConfig);
+
+  // Either a list of cameras or a single camera (legacy configuration)
+  std::vector<mc_rtc::Configuration> cameraConfigs;
+  if(config.has("cameras"))
+  {
+    auto cameras = config("cameras");
+    for(size_t i = 0; i < cameras.size(); ++i)
+    {
+      cameraConfigs.push_back(cameras[i]);
+    }
+    if(cameraConfigs.empty())
+    {
+      mc_rtc::log::error_and_throw("[{}Subscriber] cameras must contain at least one camera", Traits::name);
+    }
+  }
+  else
+  {
+    cameraConfigs.push_back(config("camera", mc_rtc::Configuration{}));
+  }
+  if(cameraConfigs.size() > std::numeric_limits<uint8_t>::max())
+  {
+    mc_rtc::log::error_and_throw("[{}Subscriber] At most {} cameras are supported", Traits::name,
+                                 std::numeric_limits<uint8_t>::max());
+  }
+  for(const auto & c : cameraConfigs)
+  {
+    CameraDescriptor camera;
+    camera.name = c("name", std::string("camera"));
+    camera.robot = c("robot", ctl.robot().name());
+    camera.frame = c("frame", std::string(""));
+    camera.offset = c("offset", sva::PTransformd::Identity());
+    for(const auto & other : cameras_)
+    {
+      if(other->descriptor.name == camera.name)
+      {
+        mc_rtc::log::error_and_throw("[{}Subscriber] Several cameras are named {}", Traits::name, camera.name);
+      }
+    }
+    if(!camera.frame.empty() && !ctl.robot(camera.robot).hasFrame(camera.frame))
+    {
+      mc_rtc::log::error_and_throw("[{}Subscriber] No frame named {} in {} for camera {}", Traits::name,
+                                   camera.frame, camera.robot, camera.name);
+    }
+    auto history = static_cast<unsigned int>(CameraPoseHistory().capacity());
+    c("history", history);
+    cameras_.emplace_back(new Camera(*this, cameras_.size(), camera, history));
+  }
+  observations_.reserve(cameras_.size());
+
+  std::string record = methodConf("record", std::string(""));
+  if(!record.empty())
+  {
+    std::vector<std::string> markerNames;
+    for(const auto & m : markers_)
+    {
+      markerNames.push_back(m.name);
+    }
+    std::vector<std::string> cameraNames;
+    for(const auto & c : cameras_)
+    {
+      cameraNames.push_back(c->descriptor.name);
+    }
+    recorder_.reset(new MarkerRecorder(record, markerNames, cameraNames));
+    ctl_.gui()->addElement({"Plugins", Traits::name},
+                           mc_rtc::gui::Label("Dropped records", [this]() { return recorder_->overflows(); }));
+  }
+
+  std::string ingestion = methodConf("ingestion", std::string("latest"));
+  unsigned int queueSize = 1000;
+  methodConf("queueSize", queueSize);
+  auto shmConf = methodConf("shm", mc_rtc::Configuration{});
+  for(size_t i = 0; i < cameras_.size(); ++i)
+  {
+    // Per-camera entries override the ones in Traits::config
+    const auto & c = cameraConfigs[i];
+    auto & camera = *cameras_[i];
+    if(sourceName_ == "simulation")
+    {
+      auto cameraSimulation = simulationConfig;
+      // Independent noise for every camera
+      cameraSimulation.degradation.seed += i;
+      camera.source.reset(new SimulationSource(
+          ctl_, std::vector<MarkerDescriptor>(markers_.begin(), markers_.end()), cameraSimulation));
+    }
+    else if(sourceName_ == "ros")
+    {
+      std::string topic = c("topic", methodConf("topic", std::string("")));
+      std::string cameraIngestion = ingestion;
+      c("ingestion", cameraIngestion);
+      if(cameraIngestion != "latest" && cameraIngestion != "all")
+      {
+        mc_rtc::log::error_and_throw("[{}Subscriber] ingestion must be latest or all (got: {})", Traits::name,
+                                     cameraIngestion);
+      }
+      camera.latestOnly = cameraIngestion == "latest";
+      unsigned int cameraQueueSize = queueSize;
+      c("queueSize", cameraQueueSize);
+      camera.source.reset(new RosSource<Message>(nh_, Traits::topics(topic, markers_),
+                                                 camera.latestOnly ? 1 : cameraQueueSize,
+                                                 [this, i](const Message & msg, size_t t) { process(msg, i, t); }));
+    }
+    else if(sourceName_ == "shm")
+    {
+      std::string name = shmConf("name", std::string("/whycon"));
+      double poll = shmConf("poll", 0.0002);
+      if(c.has("shm"))
+      {
+        c("shm")("name", name);
+        c("shm")("poll", poll);
+      }
+      camera.source.reset(new SharedMemorySource(name, poll));
+    }
+    else if(sourceName_ == "replay")
+    {
+      auto replay = new ReplaySource(static_cast<std::string>(methodConf("replay")), camera.descriptor.name);
+      camera.source.reset(replay);
+      time_ = i == 0 ? replay->startTime() : std::min(time_.load(), replay->startTime());
+    }
+  }
+  for(auto & camera : cameras_)
+  {
+    if(camera->source)
+    {
+      camera->source->start(*camera);
+    }
+  }
+
+  ctl_.gui()->addElement({"Plugins", Traits::name}, mc_rtc::gui::Label("Source", [this]() { return sourceName_; }));
+  for(auto & c : cameras_)
+  {
+    auto & camera = *c;
+    const auto & name = camera.descriptor.name;
+    const std::vector<std::string> category = {"Plugins", Traits::name, "Cameras", name};
+    ctl_.gui()->addElement(category, mc_rtc::gui::Label("Status",
+                                                        [&camera]() -> std::string
+                                                        {
+                                                          if(camera.source)
+                                                          {
+                                                            return camera.source->status();
+                                                          }
+                                                          return "external";
+                                                        }));
+    if(sourceName_ != "ros" && sourceName_ != "none")
+    {
+      continue;
+    }
+    ctl_.gui()->addElement(category,
+                           mc_rtc::gui::Label("Callback latency (last/avg/max) [ms]",
+                                              [&camera]()
+                                              {
+                                                return fmt::format("{:.1f} / {:.1f} / {:.1f}",
+                                                                   1000 * camera.callbackLatency.last.load(),
+                                                                   1000 * camera.callbackLatency.average.load(),
+                                                                   1000 * camera.callbackLatency.max.load());
+                                              }),
+                           mc_rtc::gui::Button("Reset max latency", [&camera]() { camera.callbackLatency.max = 0; }),
+                           mc_rtc::gui::Label("Ingestion",
+                                              [&camera]() { return camera.latestOnly ? "latest" : "all"; }),
+                           mc_rtc::gui::Label("Messages (processed/dropped)",
+                                              [&camera]()
+                                              {
+                                                return fmt::format("{} / {}", camera.ingestion.processed.load(),
+                                                                   camera.ingestion.dropped.load());
+                                              }),
+                           mc_rtc::gui::Label("Conflated measurements",
+                                              [&camera]() { return camera.ingestion.conflated; }));
+    const std::string prefix = Traits::name;
+    ctl_.logger().addLogEntry(prefix + "CallbackLatency_" + name,
+                              [&camera]() { return camera.callbackLatency.last.load(); });
+    ctl_.logger().addLogEntry(prefix + "Messages_" + name + "_processed",
+                              [&camera]() { return camera.ingestion.processed.load(); });
+    ctl_.logger().addLogEntry(prefix + "Messages_" + name + "_dropped",
+                              [&camera]() { return camera.ingestion.dropped.load(); });
+    ctl_.logger().addLogEntry(prefix + "Messages_" + name + "_conflated",
+                              [&camera]() { return camera.ingestion.conflated; });
+  }
+}
+
+template<typename Traits>
+MarkerSubscriber<Traits>::~MarkerSubscriber()
+{
+  for(auto & camera : cameras_)
+  {
+    if(camera->source)
+    {
+      camera->source->stop();
+    }
+  }
+  const std::string key = std::string(Traits::datastore) + "::Marker";
+  for(const auto & m : markers_)
+  {
+    ctl_.datastore().remove(key + "::" + m.name);
+    ctl_.datastore().remove(key + "Estimate::" + m.name);
+  }
+}
+
+template<typename Traits>
+void MarkerSubscriber<Traits>::process(const Message & msg, size_t cameraIndex, size_t topic)
+{
+  auto & camera = *cameras_[cameraIndex];
+  ScopedTimer timer(*camera.callbackTiming);
+  const double received = now();
+  // Fallback to the reception time if the detector does not stamp its messages
+  const double stamp = msg.header.stamp.isZero() ? received : msg.header.stamp.toSec();
+  auto & stats = camera.ingestion;
+  // Sequence numbers and stamps are only ordered within a topic
+  auto & source = camera.topics[topic];
+  if(source.lastSeq != 0 && msg.header.seq > source.lastSeq + 1)
+  { // Messages dropped by the transport (e.g. superseded in the subscription queue)
+    stats.dropped += msg.header.seq - source.lastSeq - 1;
+  }
+  source.lastSeq = msg.header.seq;
+  if(camera.latestOnly && stamp < source.lastStamp)
+  { // Older than what we already have
+    stats.dropped++;
+    return;
+  }
+  source.lastStamp = stamp;
+  stats.processed++;
+  const double latency = received - stamp;
+  auto & callbackLatency = camera.callbackLatency;
+  callbackLatency.last = latency;
+  callbackLatency.average = 0.95 * callbackLatency.average + 0.05 * latency;
+  if(latency > callbackLatency.max)
+  {
+    callbackLatency.max = latency;
+  }
+  bool updated = false;
+  Traits::decode(
+      msg, topic, [this](const std::string & name) { return index(name); },
+      [&](size_t i, const sva::PTransformd & X_camera_marker)
+      {
+        camera.measurement(i, X_camera_marker, stamp, received);
+        updated = true;
+      });
+  if(updated)
+  {
+    camera.publish();
+  }
+}
+
+template<typename Traits>
+void MarkerSubscriber<Traits>::tick(double dt)
+{
+  ScopedTimer timer(*tickTiming_);
+  if(external_)
+  {
+    time_.store(time_.load() + dt);
+  }
+  for(auto & c : cameras_)
+  {
+    if(c->source)
+    {
+      c->source->tick(now());
+    }
+  }
+  for(auto & c : cameras_)
+  {
+    auto & camera = *c;
+    camera.measurements.update();
+    camera.ingestion.conflated += camera.states.update(
+        camera.measurements.read(), [&camera](double t) { return camera.history.at(t); },
+        [this](size_t i, const sva::PTransformd & X_camera_marker, const sva::PTransformd & X_0_camera)
+        { return Traits::world(markers_[i], X_camera_marker, X_0_camera); });
+  }
+  fuse(now());
+  states_.tick(dt);
+  visibility_.update(states_);
+  const double t = now();
+  for(size_t i = 0; i < filters_.size(); ++i)
+  {
+    auto & filter = filters_[i];
+    filter.predict(dt);
+    if(states_.fresh[i])
+    {
+      filter.correct(states_.posW[i], t - states_.stamp[i]);
+      sampleAge_->record(t - states_.stamp[i]);
+    }
+  }
+  if(!registered_)
+  {
+    for(size_t i = 0; i < markers_.size(); ++i)
+    {
+      newMarker(MarkerHandle(static_cast<uint32_t>(i)));
+    }
+    registered_ = true;
+  }
+  for(size_t i = 0; i < markers_.size(); ++i)
+  {
+    auto & sample = *samples_[i];
+    sample.pose = states_.posW[i];
+    sample.age = states_.lastUpdate[i];
+    sample.stamp = states_.stamp[i];
+    sample.seq = states_.count[i];
+    sample.visible = states_.visible[i] != 0;
+    *estimates_[i] = filters_[i].estimate();
+
+    // auto & markerFrame = ctl_.robot(lshape.robot).frame("WhyconMarker_" + name);
+    // const auto & parentFrame = ctl_.robot(lshape.robot).frame(lshape.frame);
+    // markerFrame.X_p_f(lshape.posW * parentFrame.position().inv());
+  }
+}
+
+template<typename Traits>
+void MarkerSubscriber<Traits>::fuse(double t)
+{
+  for(size_t i = 0; i < markers_.size(); ++i)
+  {
+    states_.fresh[i] = 0;
+    bool fresh = false;
+    bool recovered = false;
+    observations_.clear();
+    for(const auto & c : cameras_)
+    {
+      const auto & s = c->states;
+      if(s.fresh[i])
+      {
+        const auto result = gates_[i].check(filters_[i], s.posW[i], t - s.stamp[i]);
+        c->rejected[i] = result == MarkerGate::Result::Outlier || result == MarkerGate::Result::Flip;
+        recovered = recovered || result == MarkerGate::Result::Recovered;
+        fresh = fresh || !c->rejected[i];
+      }
+      if(s.count[i] != 0 && !c->rejected[i])
+      {
+        observations_.push_back({s.posW[i], s.pos[i].translation().norm(), s.stamp[i], c->id});
+      }
+    }
+    if(!fresh)
+    {
+      continue;
+    }
+    sva::PTransformd X_0_marker;
+    double stamp = 0;
+    const auto & observation =
+        observations_[fusion_.fuse(observations_.data(), observations_.size(), X_0_marker, stamp)];
+    const auto best = observation.camera;
+    const auto & s = cameras_[best]->states;
+    states_.assign(i, s.pos[i], X_0_marker, stamp, s.latency[i], static_cast<uint32_t>(best));
+    visibility_.observe(i, stamp, X_0_marker.translation());
+    if(recovered)
+    { // The marker jumped, do not blend its new pose with the previous estimate
+      filters_[i].reset(X_0_marker);
+    }
+  }
+}
+
+template<typename Traits>
+void MarkerSubscriber<Traits>::cameraPose(size_t camera, const sva::PTransformd & pose)
+{
+  auto & c = *cameras_[camera];
+  if(c.source && c.source->providesCameraPose())
+  { // The poses provided by the source are used instead
+    return;
+  }
+  c.camera(now(), pose);
+}
+
+template<typename Traits>
+double MarkerSubscriber<Traits>::now() const
+{
+  if(external_)
+  {
+    return time_;
+  }
+  if(nh_)
+  {
+    return ros::Time::now().toSec();
+  }
+  return SharedMemoryRing::now();
+}
+
+template<typename Traits>
+MarkerHandle MarkerSubscriber<Traits>::handle(const std::string & name) const
+{
+  auto it = indices_.find(name);
+  if(it == indices_.end())
+  {
+    mc_rtc::log::error_and_throw("[{}Subscriber] No marker named \"{}\"", Traits::name, name);
+  }
+  return MarkerHandle(static_cast<uint32_t>(it->second));
+}
+
+template<typename Traits>
+bool MarkerSubscriber<Traits>::visible(const std::string & marker) const
+{
+  auto it = indices_.find(marker);
+  return it != indices_.end() && states_.visible[it->second];
+}
+
+template<typename Traits>
+double MarkerSubscriber<Traits>::confidence(const std::string & marker) const
+{
+  auto it = indices_.find(marker);
+  return it != indices_.end() ? states_.confidence[it->second] : 0.0;
+}
+
+template<typename Traits>
+const sva::PTransformd & MarkerSubscriber<Traits>::X_camera_marker(const std::string & marker) const
+{
+  return X_camera_marker(handle(marker));
+}
+
+template<typename Traits>
+const sva::PTransformd & MarkerSubscriber<Traits>::X_0_marker(const std::string & marker) const
+{
+  return X_0_marker(handle(marker));
+}
+
+template<typename Traits>
+size_t MarkerSubscriber<Traits>::commonCamera(MarkerHandle a, MarkerHandle b) const
+{
+  const auto i = a.index;
+  const auto j = b.index;
+  if(!states_.visible[i] || !states_.visible[j])
+  {
+    return npos;
+  }
+  if(cameras_.size() == 1)
+  {
+    return 0;
+  }
+  const double window = fusion_.config().window;
+  size_t best = npos;
+  double bestStamp = -std::numeric_limits<double>::infinity();
+  for(const auto & c : cameras_)
+  {
+    const auto & s = c->states;
+    if(s.count[i] == 0 || s.count[j] == 0 || c->rejected[i] || c->rejected[j]
+       || states_.stamp[i] - s.stamp[i] > window || states_.stamp[j] - s.stamp[j] > window)
+    {
+      continue;
+    }
+    const double stamp = std::min(s.stamp[i], s.stamp[j]);
+    if(stamp > bestStamp)
+    {
+      best = c->id;
+      bestStamp = stamp;
+    }
+  }
+  return best;
+}
+
+template<typename Traits>
+size_t MarkerSubscriber<Traits>::index(const std::string & name) const
+{
+  auto it = indices_.find(name);
+  return it != indices_.end() ? it->second : npos;
+}
+
+template<typename Traits>
+void MarkerSubscriber<Traits>::newMarker(MarkerHandle marker)
+{
+  const auto & name = markers_[marker.index].name;
+  const auto idx = marker.index;
+  mc_rtc::log::info("[{}Subscriber] New marker: {}", Traits::name, name);
+  const std::string entry = std::string(Traits::name) + "Markers_" + name;
+  ctl_.logger().addLogEntry(entry,
+                            [this, idx]() -> const sva::PTransformd & { return states_.pos[idx]; });
+  ctl_.logger().addLogEntry(entry + "_World",
+                            [this, idx]() -> const sva::PTransformd & { return states_.posW[idx]; });
+  ctl_.logger().addLogEntry(entry + "_Latency", [this, idx]() { return states_.latency[idx]; });
+  ctl_.logger().addLogEntry(entry + "_Confidence",
+                            [this, idx]() { return states_.confidence[idx]; });
+  ctl_.logger().addLogEntry(entry + "_GateDistance",
+                            [this, idx]() { return gates_[idx].distance(); });
+  ctl_.logger().addLogEntry(entry + "_Outliers", [this, idx]() { return gates_[idx].outliers(); });
+  ctl_.logger().addLogEntry(entry + "_Flips", [this, idx]() { return gates_[idx].flips(); });
+  if(cameras_.size() > 1)
+  {
+    ctl_.logger().addLogEntry(entry + "_Camera",
+                              [this, idx]() { return static_cast<uint64_t>(states_.camera[idx]); });
+  }
+  ctl_.logger().addLogEntry(entry + "_Filtered",
+                            [this, idx]() -> const sva::PTransformd & { return filters_[idx].estimate().pose; });
+  ctl_.logger().addLogEntry(entry + "_Velocity",
+                            [this, idx]() -> const sva::MotionVecd & { return filters_[idx].estimate().velocity; });
+  auto gui = ctl_.gui();
+  if(!gui)
+  {
+    return;
+  }
+  gui->addElement({"Plugins", Traits::name, "Markers"},
+                  mc_rtc::gui::Transform(name, [this, idx]() { return states_.posW[idx]; }),
+                  mc_rtc::gui::Label(name + " confidence",
+                                     [this, idx]()
+                                     {
+                                       return fmt::format("{:.2f} (every {:.0f} ms, {:.2f} m/s)",
+                                                          states_.confidence[idx],
+                                                          1000 * visibility_.interval(idx), visibility_.speed(idx));
+                                     }));
+  gui->addElement({"Plugins", Traits::name, "Gating"},
+                  mc_rtc::gui::Label(name + " (outliers/flips/recoveries)",
+                                     [this, idx]()
+                                     {
+                                       const auto & gate = gates_[idx];
+                                       return fmt::format("{} / {} / {}", gate.outliers(), gate.flips(),
+                                                          gate.recoveries());
+                                     }),
+                  mc_rtc::gui::Button("Reset " + name + " counters", [this, idx]() { gates_[idx].clear(); }));
+}
+
+} // namespace whycon_plugin
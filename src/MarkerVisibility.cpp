@@ -0,0 +1,99 @@
+#include <mc_whycon_plugin/MarkerVisibility.h>
+
+#include <mc_rtc/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace whycon_plugin
+{
+
+namespace
+{
+
+/** Number of intervals needed before the adaptive confidence is used */
+constexpr uint64_t MIN_SAMPLES = 3;
+
+} // namespace
+
+void MarkerVisibilityConfig::load(const mc_rtc::Configuration & config)
+{
+  config("adaptive", adaptive);
+  config("timeout", timeout);
+  config("lateness", lateness);
+  config("tolerance", tolerance);
+  config("smoothing", smoothing);
+  config("threshold", threshold);
+  if(timeout <= 0 || lateness <= 0 || tolerance <= 0)
+  {
+    mc_rtc::log::error_and_throw("[MarkerVisibility] timeout, lateness and tolerance must be strictly positive");
+  }
+  if(smoothing <= 0 || smoothing > 1)
+  {
+    mc_rtc::log::error_and_throw("[MarkerVisibility] smoothing must be in ]0, 1] (got: {})", smoothing);
+  }
+}
+
+void MarkerVisibility::add(const MarkerVisibilityConfig & config)
+{
+  configs_.push_back(config);
+  samples_.push_back(0);
+  interval_.push_back(0);
+  intervalVariance_.push_back(0);
+  speed_.push_back(0);
+  lastStamp_.push_back(-std::numeric_limits<double>::infinity());
+  lastPosition_.push_back(Eigen::Vector3d::Zero());
+}
+
+void MarkerVisibility::observe(size_t i, double stamp, const Eigen::Vector3d & position)
+{
+  const auto & config = configs_[i];
+  const double dt = stamp - lastStamp_[i];
+  // Updates separated by more than the timeout are gaps in the detection, not arrivals
+  if(dt > 0 && dt < config.timeout)
+  {
+    const double speed = (position - lastPosition_[i]).norm() / dt;
+    if(samples_[i] == 0)
+    {
+      interval_[i] = dt;
+      intervalVariance_[i] = 0;
+      speed_[i] = speed;
+    }
+    else
+    {
+      const double a = config.smoothing;
+      const double d = dt - interval_[i];
+      interval_[i] += a * d;
+      intervalVariance_[i] = (1 - a) * (intervalVariance_[i] + a * d * d);
+      speed_[i] += a * (speed - speed_[i]);
+    }
+    samples_[i]++;
+  }
+  lastStamp_[i] = stamp;
+  lastPosition_[i] = position;
+}
+
+void MarkerVisibility::update(MarkerStates & states) const
+{
+  const size_t n = size();
+  for(size_t i = 0; i < n; ++i)
+  {
+    const auto & config = configs_[i];
+    const double age = states.lastUpdate[i];
+    double confidence = age < config.timeout ? 1.0 : 0.0;
+    if(confidence > 0 && config.adaptive && samples_[i] >= MIN_SAMPLES)
+    {
+      const double sigma = std::max(std::sqrt(intervalVariance_[i]), 0.5 * interval_[i]);
+      // Both terms only grow once the next update is overdue
+      const double overdue = std::max(age - interval_[i], 0.0);
+      const double late = overdue / (config.lateness * sigma);
+      const double drift = speed_[i] * overdue / config.tolerance;
+      confidence = std::exp(-0.5 * (late * late + drift * drift));
+    }
+    states.confidence[i] = confidence;
+    states.visible[i] = confidence > 0 && confidence >= config.threshold;
+  }
+}
+
+} // namespace whycon_plugin
@@ -0,0 +1,73 @@
+#include <mc_whycon_plugin/ReplaySource.h>
+
+#include <mc_rtc/logging.h>
+
+#include <algorithm>
+
+namespace whycon_plugin
+{
+
+ReplaySource::ReplaySource(const std::string & path, const std::string & camera) : replay_(path)
+{
+  const auto & cameras = replay_.cameras();
+  camera_ = static_cast<size_t>(std::find(cameras.begin(), cameras.end(), camera) - cameras.begin());
+  if(camera_ == cameras.size())
+  {
+    if(cameras.size() == 1)
+    {
+      mc_rtc::log::warning("[WhyConSubscriber] No camera {} in {}, replaying {} instead", camera, path, cameras[0]);
+      camera_ = 0;
+    }
+    else
+    {
+      mc_rtc::log::warning("[WhyConSubscriber] No camera {} in {}, nothing will be replayed for this camera", camera,
+                           path);
+    }
+  }
+  if(!replay_.done())
+  {
+    startTime_ = replay_.nextTime();
+  }
+}
+
+void ReplaySource::start(MeasurementSink & sink)
+{
+  sink_ = &sink;
+  indices_.clear();
+  for(const auto & m : replay_.markers())
+  {
+    indices_.push_back(sink.index(m));
+  }
+  mc_rtc::log::info("[WhyConSubscriber] Replaying {}", replay_.path());
+}
+
+void ReplaySource::tick(double t)
+{
+  bool updated = false;
+  while(!replay_.done() && replay_.nextTime() <= t)
+  {
+    const auto & r = replay_.next();
+    const bool replayed = r.camera == camera_;
+    if(replayed && r.type == recording::RecordType::Camera)
+    {
+      sink_->camera(r.stamp, r.pose);
+    }
+    else if(replayed && r.type == recording::RecordType::Measurement && r.marker < indices_.size()
+            && indices_[r.marker] != MeasurementSink::npos)
+    {
+      sink_->measurement(indices_[r.marker], r.pose, r.stamp, r.received);
+      updated = true;
+    }
+    replay_.pop();
+    if(replay_.done())
+    {
+      mc_rtc::log::success("[WhyConSubscriber] Replay of {} completed", replay_.path());
+    }
+  }
+  if(updated)
+  {
+    sink_->publish();
+  }
+}
+
+} // namespace whycon_plugin
@@ -0,0 +1,113 @@
+#include <mc_whycon_plugin/SensorModel.h>
+
+#include <mc_rtc/constants.h>
+
+#include <cmath>
+#include <limits>
+
+namespace whycon_plugin
+{
+
+void SensorModelConfig::load(const mc_rtc::Configuration & config)
+{
+  config("seed", seed);
+  config("latency", latency);
+  config("jitter", jitter);
+  config("positionNoise", positionNoise);
+  config("orientationNoise", orientationNoise);
+  config("referenceDistance", referenceDistance);
+  config("distanceExponent", distanceExponent);
+  config("angleGain", angleGain);
+  config("dropoutProbability", dropoutProbability);
+  config("dropoutDuration", dropoutDuration);
+  config("horizontalFov", horizontalFov);
+  config("verticalFov", verticalFov);
+  config("maxDistance", maxDistance);
+  config("maxViewingAngle", maxViewingAngle);
+  if(latency < 0 || jitter < 0)
+  {
+    mc_rtc::log::error_and_throw("[SensorModel] latency and jitter must be positive");
+  }
+  if(referenceDistance <= 0)
+  {
+    mc_rtc::log::error_and_throw("[SensorModel] referenceDistance must be strictly positive");
+  }
+}
+
+SensorModel::SensorModel(const SensorModelConfig & config, size_t markers)
+: config_(config), rng_(config.seed), dropoutUntil_(markers, -std::numeric_limits<double>::infinity())
+{
+}
+
+double SensorModel::latency()
+{
+  return config_.latency + config_.jitter * uniform_(rng_);
+}
+
+bool SensorModel::inView(const sva::PTransformd & X_camera_marker, double & cosAngle) const
+{
+  const Eigen::Vector3d & p = X_camera_marker.translation();
+  const double d = p.norm();
+  // Marker normal in the camera frame (E = R^T)
+  const Eigen::Vector3d n = X_camera_marker.rotation().row(2).transpose();
+  cosAngle = d > 0 ? std::abs(n.dot(p)) / d : 1.0;
+  constexpr double deg = mc_rtc::constants::PI / 180;
+  const bool fov = config_.horizontalFov > 0 || config_.verticalFov > 0;
+  if(fov && p.z() <= 0)
+  { // Behind the camera, only meaningful if the frame is an optical frame
+    return false;
+  }
+  if(config_.horizontalFov > 0 && std::abs(std::atan2(p.x(), p.z())) > 0.5 * config_.horizontalFov * deg)
+  {
+    return false;
+  }
+  if(config_.verticalFov > 0 && std::abs(std::atan2(p.y(), p.z())) > 0.5 * config_.verticalFov * deg)
+  {
+    return false;
+  }
+  if(config_.maxDistance > 0 && d > config_.maxDistance)
+  {
+    return false;
+  }
+  return config_.maxViewingAngle >= 90 || cosAngle >= std::cos(config_.maxViewingAngle * deg);
+}
+
+bool SensorModel::observe(size_t marker, double t, sva::PTransformd & X_camera_marker)
+{
+  double cosAngle = 1.0;
+  if(!inView(X_camera_marker, cosAngle))
+  {
+    occluded_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if(t < dropoutUntil_[marker])
+  {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if(config_.dropoutProbability > 0 && uniform_(rng_) < config_.dropoutProbability)
+  {
+    // Exponentially distributed burst duration
+    dropoutUntil_[marker] = t - config_.dropoutDuration * std::log(1.0 - uniform_(rng_));
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if(config_.positionNoise > 0 || config_.orientationNoise > 0)
+  {
+    const double d = X_camera_marker.translation().norm();
+    const double scale = std::pow(d / config_.referenceDistance, config_.distanceExponent)
+                         * (1 + config_.angleGain * (1 - cosAngle));
+    const Eigen::Vector3d dp = Eigen::Vector3d{normal_(rng_), normal_(rng_), normal_(rng_)};
+    const Eigen::Vector3d dw = Eigen::Vector3d{normal_(rng_), normal_(rng_), normal_(rng_)};
+    X_camera_marker.translation() += scale * config_.positionNoise * dp;
+    const Eigen::Vector3d w = scale * config_.orientationNoise * dw;
+    const double angle = w.norm();
+    if(angle > 0)
+    {
+      X_camera_marker.rotation() = Eigen::AngleAxisd(angle, w / angle).toRotationMatrix() * X_camera_marker.rotation();
+    }
+  }
+  return true;
+}
+
+} // namespace whycon_plugin
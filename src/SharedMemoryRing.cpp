@@ -0,0 +1,171 @@
+#include <mc_whycon_plugin/SharedMemoryRing.h>
+
+#include <mc_rtc/logging.h>
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace whycon_plugin
+{
+
+namespace
+{
+
+size_t segmentSize(uint32_t capacity)
+{
+  return sizeof(shm::Header) + capacity * sizeof(shm::Slot);
+}
+
+} // namespace
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::create(const std::string & name, uint32_t capacity)
+{
+  if(capacity == 0)
+  {
+    mc_rtc::log::error_and_throw("[SharedMemoryRing] The capacity of {} must be strictly positive", name);
+  }
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if(fd < 0)
+  {
+    mc_rtc::log::error_and_throw("[SharedMemoryRing] Cannot create {}: {}", name, std::strerror(errno));
+  }
+  const size_t size = segmentSize(capacity);
+  if(ftruncate(fd, static_cast<off_t>(size)) != 0)
+  {
+    close(fd);
+    mc_rtc::log::error_and_throw("[SharedMemoryRing] Cannot resize {}: {}", name, std::strerror(errno));
+  }
+  void * data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED)
+  {
+    mc_rtc::log::error_and_throw("[SharedMemoryRing] Cannot map {}: {}", name, std::strerror(errno));
+  }
+  // The segment is zero-initialized by ftruncate
+  auto header = new(data) shm::Header;
+  header->capacity = capacity;
+  header->session = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+  header->head.store(0, std::memory_order_relaxed);
+  auto slots = reinterpret_cast<shm::Slot *>(header + 1);
+  for(uint32_t i = 0; i < capacity; ++i)
+  {
+    new(&slots[i]) shm::Slot;
+    slots[i].seq.store(0, std::memory_order_relaxed);
+  }
+  header->version = shm::Version;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = shm::Magic;
+  return std::unique_ptr<SharedMemoryRing>(new SharedMemoryRing(name, data, size, capacity, true));
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::open(const std::string & name)
+{
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if(fd < 0)
+  {
+    return nullptr;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(shm::Header))
+  {
+    close(fd);
+    return nullptr;
+  }
+  const auto size = static_cast<size_t>(st.st_size);
+  void * data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED)
+  {
+    return nullptr;
+  }
+  auto header = static_cast<const shm::Header *>(data);
+  if(header->magic != shm::Magic)
+  {
+    munmap(data, size);
+    return nullptr;
+  }
+  // Pairs with the release fence of create(): the rest of the header is initialized
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint32_t capacity = header->capacity;
+  if(header->version != shm::Version || capacity == 0 || size < segmentSize(capacity))
+  {
+    munmap(data, size);
+    return nullptr;
+  }
+  return std::unique_ptr<SharedMemoryRing>(new SharedMemoryRing(name, data, size, capacity, false));
+}
+
+SharedMemoryRing::SharedMemoryRing(const std::string & name, void * data, size_t size, uint32_t capacity, bool owner)
+: name_(name), data_(data), size_(size), capacity_(capacity), owner_(owner), header_(static_cast<shm::Header *>(data)),
+  slots_(reinterpret_cast<shm::Slot *>(header_ + 1))
+{
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+  munmap(data_, size_);
+  if(owner_)
+  {
+    shm_unlink(name_.c_str());
+  }
+}
+
+void SharedMemoryRing::write(const std::string & marker, double stamp, const sva::PTransformd & X_camera_marker) noexcept
+{
+  const uint64_t idx = header_->head.load(std::memory_order_relaxed);
+  auto & slot = slots_[idx % capacity_];
+  const uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.index = idx;
+  const size_t n = std::min(marker.size(), shm::MaxName - 1);
+  std::memcpy(slot.name, marker.data(), n);
+  slot.name[n] = '\0';
+  slot.stamp = stamp;
+  const Eigen::Quaterniond q(X_camera_marker.rotation());
+  const auto & t = X_camera_marker.translation();
+  slot.pose[0] = q.w();
+  slot.pose[1] = q.x();
+  slot.pose[2] = q.y();
+  slot.pose[3] = q.z();
+  slot.pose[4] = t.x();
+  slot.pose[5] = t.y();
+  slot.pose[6] = t.z();
+  slot.seq.store(seq + 2, std::memory_order_release);
+  header_->head.store(idx + 1, std::memory_order_release);
+}
+
+bool SharedMemoryRing::read(uint64_t idx, shm::Measurement & out) const noexcept
+{
+  const auto & slot = slots_[idx % capacity_];
+  const uint32_t seq = slot.seq.load(std::memory_order_acquire);
+  if(seq & 1)
+  {
+    return false;
+  }
+  const uint64_t index = slot.index;
+  std::memcpy(out.name, slot.name, shm::MaxName);
+  out.name[shm::MaxName - 1] = '\0';
+  out.stamp = slot.stamp;
+  double p[7];
+  std::memcpy(p, slot.pose, sizeof(p));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if(slot.seq.load(std::memory_order_relaxed) != seq || index != idx)
+  {
+    return false;
+  }
+  out.pose = {Eigen::Quaterniond{p[0], p[1], p[2], p[3]}, Eigen::Vector3d{p[4], p[5], p[6]}};
+  return true;
+}
+
+double SharedMemoryRing::now() noexcept
+{
+  return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace whycon_plugin
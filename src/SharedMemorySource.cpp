@@ -0,0 +1,106 @@
+#include <mc_whycon_plugin/SharedMemorySource.h>
+
+#include <mc_rtc/logging.h>
+
+#include <chrono>
+
+namespace whycon_plugin
+{
+
+SharedMemorySource::SharedMemorySource(const std::string & name, double poll) : name_(name), poll_(poll) {}
+
+SharedMemorySource::~SharedMemorySource()
+{
+  stop();
+}
+
+void SharedMemorySource::start(MeasurementSink & sink)
+{
+  running_ = true;
+  thread_ = std::thread(
+      [this, &sink]()
+      {
+        using clock = std::chrono::steady_clock;
+        const auto poll = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(poll_));
+        std::unique_ptr<SharedMemoryRing> ring;
+        uint64_t tail = 0;
+        auto lastCheck = clock::now();
+        shm::Measurement m;
+        while(running_)
+        {
+          const auto now = clock::now();
+          if(!ring || now - lastCheck > std::chrono::seconds(1))
+          { // Wait for the detector or check that it did not re-create the segment
+            lastCheck = now;
+            auto current = SharedMemoryRing::open(name_);
+            if(current && (!ring || current->session() != ring->session()))
+            {
+              mc_rtc::log::success("[SharedMemorySource] Connected to {}", name_);
+              ring = std::move(current);
+              tail = ring->head();
+              connected_ = true;
+            }
+            else if(!current && ring)
+            {
+              mc_rtc::log::warning("[SharedMemorySource] {} was removed", name_);
+              ring.reset();
+              connected_ = false;
+            }
+            if(!ring)
+            {
+              std::this_thread::sleep_for(std::chrono::milliseconds(100));
+              continue;
+            }
+          }
+          const uint64_t head = ring->head();
+          if(head - tail > ring->capacity())
+          {
+            overruns_ += head - tail - ring->capacity();
+            tail = head - ring->capacity();
+          }
+          if(head == tail)
+          {
+            std::this_thread::sleep_for(poll);
+            continue;
+          }
+          const double received = sink.now();
+          bool updated = false;
+          for(; tail < head; ++tail)
+          {
+            if(!ring->read(tail, m))
+            {
+              overruns_++;
+              continue;
+            }
+            const auto idx = sink.index(m.name);
+            if(idx != MeasurementSink::npos)
+            {
+              sink.measurement(idx, m.pose, m.stamp, received);
+              updated = true;
+            }
+            received_++;
+          }
+          if(updated)
+          {
+            sink.publish();
+          }
+        }
+      });
+}
+
+void SharedMemorySource::stop()
+{
+  running_ = false;
+  if(thread_.joinable())
+  {
+    thread_.join();
+  }
+}
+
+std::string SharedMemorySource::status() const
+{
+  return fmt::format("{} {} ({} received, {} overruns)", connected_ ? "connected to" : "waiting for", name_, received(),
+                     overruns());
+}
+
+} // namespace whycon_plugin
@@ -0,0 +1,190 @@
+#include <mc_whycon_plugin/SimulationSource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace whycon_plugin
+{
+
+void SimulationConfig::load(const mc_rtc::Configuration & config)
+{
+  config("rate", rate);
+  config("lockstep", lockstep);
+  if(config.has("degradation"))
+  {
+    degradation.load(config("degradation"));
+  }
+  if(rate <= 0)
+  {
+    mc_rtc::log::error_and_throw("[SimulationSource] simulation/rate must be strictly positive (got: {})", rate);
+  }
+}
+
+SimulationSource::SimulationSource(const mc_control::MCController & ctl,
+                                   std::vector<MarkerDescriptor> markers,
+                                   const SimulationConfig & config)
+: ctl_(ctl), markers_(std::move(markers)), config_(config), model_(config.degradation, markers_.size())
+{
+  Snapshot snapshot;
+  snapshot.X_0_markers.resize(markers_.size(), sva::PTransformd::Identity());
+  snapshots_.reset(snapshot);
+  // Enough frames to cover the maximum latency
+  const auto n = static_cast<size_t>(std::ceil(config_.degradation.maxLatency() * config_.rate)) + 2;
+  Frame frame;
+  frame.detected.resize(markers_.size(), 0);
+  frame.X_camera_marker.resize(markers_.size(), sva::PTransformd::Identity());
+  frames_.resize(n, frame);
+}
+
+SimulationSource::~SimulationSource()
+{
+  stop();
+}
+
+void SimulationSource::start(MeasurementSink & sink)
+{
+  sink_ = &sink;
+  next_ = sink.now();
+  if(config_.lockstep)
+  {
+    return;
+  }
+  running_ = true;
+  thread_ = std::thread(
+      [this]()
+      {
+        using clock = std::chrono::steady_clock;
+        const auto period =
+            std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / config_.rate));
+        auto next = clock::now();
+        while(running_)
+        {
+          auto now = clock::now();
+          if(now >= next)
+          {
+            snapshots_.update();
+            // Wait for the first snapshot
+            if(snapshots_.read().t != 0)
+            {
+              capture(snapshots_.read());
+            }
+            next += period;
+          }
+          deliver(sink_->now());
+          // Wake up for the next capture or the next delivery
+          auto wakeup = next;
+          if(count_ != 0)
+          {
+            const auto delay = std::chrono::duration<double>(frames_[head_].deliver - sink_->now());
+            wakeup = std::min(wakeup, clock::now() + std::chrono::duration_cast<clock::duration>(delay));
+          }
+          std::this_thread::sleep_until(wakeup);
+        }
+      });
+}
+
+void SimulationSource::stop()
+{
+  running_ = false;
+  if(thread_.joinable())
+  {
+    thread_.join();
+  }
+}
+
+void SimulationSource::tick(double t)
+{
+  if(config_.lockstep && t < next_)
+  {
+    deliver(t);
+    return;
+  }
+  auto & snapshot = snapshots_.write();
+  snapshot.t = t;
+  snapshot.X_0_camera = X_0_camera_;
+  for(size_t i = 0; i < markers_.size(); ++i)
+  {
+    const auto & marker = markers_[i];
+    const auto & robot = ctl_.robot(marker.robot);
+    snapshot.X_0_markers[i] = marker.frameOffset * robot.frame(marker.frame).position();
+  }
+  if(config_.lockstep)
+  {
+    capture(snapshot);
+    deliver(t);
+    // Catch up without generating several measurements if the controller is late
+    next_ += 1.0 / config_.rate;
+    if(next_ <= t)
+    {
+      next_ = t + 1.0 / config_.rate;
+    }
+  }
+  else
+  {
+    snapshots_.publish();
+  }
+}
+
+void SimulationSource::cameraPose(double, const sva::PTransformd & X_0_camera)
+{
+  X_0_camera_ = X_0_camera;
+}
+
+std::string SimulationSource::status() const
+{
+  return fmt::format("{} ({} dropped, {} out of view)", config_.lockstep ? "simulation (lockstep)" : "simulation",
+                     model_.dropped(), model_.occluded());
+}
+
+void SimulationSource::capture(const Snapshot & snapshot)
+{
+  if(count_ == frames_.size())
+  { // Should not happen unless the rate is not respected
+    deliverOldest(snapshot.t);
+  }
+  auto & frame = frames_[(head_ + count_) % frames_.size()];
+  frame.stamp = snapshot.t;
+  frame.deliver = snapshot.t + model_.latency();
+  if(count_ != 0)
+  { // Frames are delivered in order
+    frame.deliver = std::max(frame.deliver, frames_[(head_ + count_ - 1) % frames_.size()].deliver);
+  }
+  const auto X_camera_0 = snapshot.X_0_camera.inv();
+  for(size_t i = 0; i < snapshot.X_0_markers.size(); ++i)
+  {
+    frame.X_camera_marker[i] = snapshot.X_0_markers[i] * X_camera_0;
+    frame.detected[i] = model_.observe(i, snapshot.t, frame.X_camera_marker[i]);
+  }
+  count_++;
+}
+
+void SimulationSource::deliver(double t)
+{
+  while(count_ != 0 && frames_[head_].deliver <= t)
+  {
+    deliverOldest(t);
+  }
+}
+
+void SimulationSource::deliverOldest(double received)
+{
+  const auto & frame = frames_[head_];
+  bool updated = false;
+  for(size_t i = 0; i < frame.detected.size(); ++i)
+  {
+    if(frame.detected[i])
+    {
+      sink_->measurement(i, frame.X_camera_marker[i], frame.stamp, received);
+      updated = true;
+    }
+  }
+  if(updated)
+  {
+    sink_->publish();
+  }
+  head_ = (head_ + 1) % frames_.size();
+  count_--;
+}
+
+} // namespace whycon_plugin
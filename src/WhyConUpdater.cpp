@@ -10,32 +10,68 @@ WhyConUpdater::WhyConUpdater(const WhyConSubscriber & subscriber,
                              const std::string & env,
                              const sva::PTransformd & envOffset,
                              const sva::PTransformd & frameOffset)
+: WhyConUpdater(subscriber, subscriber.handle(frame), subscriber.handle(env), envOffset, frameOffset)
+{
+}
+
+WhyConUpdater::WhyConUpdater(const WhyConSubscriber & subscriber,
+                             MarkerHandle frame,
+                             MarkerHandle env,
+                             const sva::PTransformd & envOffset,
+                             const sva::PTransformd & frameOffset)
 : subscriber_(subscriber), frame_(frame), env_(env), envOffset_(envOffset), frameOffset_(frameOffset)
 {
 }
 
-bool WhyConUpdater::update(mc_tasks::MetaTask & task_)
+bool WhyConUpdater::upToDate(LastUpdate & last, const mc_tasks::MetaTask & task, size_t camera)
 {
-  auto & task = static_cast<mc_tasks::PositionBasedVisServoTask &>(task_);
+  if(last.task == &task && last.camera == camera && !subscriber_.hasNewSample(frame_, last.frame)
+     && !subscriber_.hasNewSample(env_, last.env))
+  {
+    return true;
+  }
+  last.task = &task;
+  last.camera = camera;
+  last.frame = subscriber_.seq(frame_);
+  last.env = subscriber_.seq(env_);
+  return false;
+}
+
+bool WhyConUpdater::update(mc_tasks::MetaTask & metaTask)
+{
+  auto & task = static_cast<mc_tasks::PositionBasedVisServoTask &>(metaTask);
   bool visible = true;
   if(!subscriber_.visible(frame_))
   {
     visible = false;
-    mc_rtc::log::error("[WhyConUpdater] Cannot see {} marker", frame_);
+    mc_rtc::log::error("[WhyConUpdater] Cannot see {} marker", subscriber_.name(frame_));
   }
   if(!subscriber_.visible(env_))
   {
     visible = false;
-    mc_rtc::log::error("[WhyConUpdater] Cannot see {} marker", env_);
+    mc_rtc::log::error("[WhyConUpdater] Cannot see {} marker", subscriber_.name(env_));
+  }
+  // Both positions must be expressed in the same camera
+  const auto camera = visible ? subscriber_.commonCamera(frame_, env_) : WhyConSubscriber::npos;
+  if(visible && camera == WhyConSubscriber::npos)
+  {
+    visible = false;
+    mc_rtc::log::error("[WhyConUpdater] No camera sees both {} and {} markers", subscriber_.name(frame_),
+                       subscriber_.name(env_));
   }
   if(!visible)
   {
     task.error(sva::PTransformd::Identity());
+    task_.task = nullptr;
     return false;
   }
+  if(upToDate(task_, task, camera))
+  {
+    return true;
+  }
   static bool once = true;
-  auto X_camera_target = envOffset_ * subscriber_.X_camera_marker(env_);
-  auto X_camera_frame = frameOffset_ * subscriber_.X_camera_marker(frame_);
+  auto X_camera_target = envOffset_ * subscriber_.X_camera_marker(env_, camera);
+  auto X_camera_frame = frameOffset_ * subscriber_.X_camera_marker(frame_, camera);
   auto X_t_s = X_camera_frame * X_camera_target.inv();
   if(once)
   {
@@ -69,9 +105,14 @@ bool WhyConUpdater::updateLookAt(mc_tasks::LookAtTask & task)
 {
   if(subscriber_.visible(env_))
   {
+    if(upToDate(lookAt_, task, 0))
+    {
+      return true;
+    }
     task.target(sva::interpolate(subscriber_.X_0_marker(frame_), subscriber_.X_0_marker(env_), 0.5).translation());
     return true;
   }
+  lookAt_.task = nullptr;
   return false;
 }
 
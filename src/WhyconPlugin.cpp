@@ -1,31 +1,71 @@
 #include <mc_rbdyn/rpy_utils.h>
+#include <mc_whycon_plugin/VISPSubscriber.h>
 #include <mc_whycon_plugin/WhyConSubscriber.h>
 #include <mc_whycon_plugin/WhyConUpdater.h>
 #include <mc_whycon_plugin/WhyconPlugin.h>
 
+#include <algorithm>
+
 namespace whycon_plugin
 {
 
-WhyconPlugin::WhyconPlugin() : nh_(mc_rtc::ROSBridge::get_node_handle())
+namespace
+{
+
+/** Check the camera frames and add the camera offsets inputs to the GUI */
+template<typename Traits>
+void addCameras(mc_control::MCController & ctl, MarkerSubscriber<Traits> & subscriber)
 {
-  if(!nh_)
+  for(size_t i = 0; i < subscriber.cameras(); ++i)
   {
-    mc_rtc::log::error_and_throw("[WhyconPlugin] ROS is not available");
+    auto & camera = subscriber.camera(i);
+    if(camera.frame.empty())
+    {
+      mc_rtc::log::error_and_throw("[WhyconPlugin] No frame in the configuration of camera {}", camera.name);
+    }
+    ctl.gui()->addElement({"Plugins", Traits::name, "Cameras", camera.name},
+                          mc_rtc::gui::ArrayInput(
+                              "Camera offset RPY [deg]", {"x", "y", "z"},
+                              [&camera]() -> Eigen::Vector3d {
+                                return mc_rbdyn::rpyFromMat(camera.offset.rotation()) * 180 / mc_rtc::constants::PI;
+                              },
+                              [&camera](const Eigen::Vector3d & offset) {
+                                camera.offset.rotation() = mc_rbdyn::rpyToMat(offset * mc_rtc::constants::PI / 180);
+                              }),
+                          mc_rtc::gui::ArrayInput(
+                              "Camera offset translation [m]", {"x", "y", "z"},
+                              [&camera]() -> const Eigen::Vector3d & { return camera.offset.translation(); },
+                              [&camera](const Eigen::Vector3d & offset) { camera.offset.translation() = offset; }));
   }
 }
 
-WhyconPlugin::~WhyconPlugin()
+/** Provide the camera poses then update the subscriber */
+template<typename Traits>
+void update(mc_control::MCController & ctl, MarkerSubscriber<Traits> & subscriber)
 {
-  if(spinner_.joinable())
+  for(size_t i = 0; i < subscriber.cameras(); ++i)
   {
-    spinner_.join();
+    const auto & camera = subscriber.camera(i);
+    subscriber.cameraPose(i, camera.offset * ctl.realRobot(camera.robot).frame(camera.frame).position());
   }
+  subscriber.tick(ctl.timeStep);
 }
 
+} // namespace
+
+WhyconPlugin::WhyconPlugin() = default;
+
+WhyconPlugin::~WhyconPlugin() = default;
+
 void WhyconPlugin::init(mc_control::MCGlobalController & controller, const mc_rtc::Configuration & config)
 {
   auto & ctl = controller.controller();
   whyconSubscriber_ = std::make_shared<WhyConSubscriber>(ctl, config);
+  if(config.has("visp"))
+  { // VISP objects, seen by the same cameras
+    vispSubscriber_ = std::make_shared<VISPSubscriber>(ctl, config);
+  }
+  beforeTiming_ = &whyconSubscriber_->instrumentation().stage("WhyconPlugin::before");
 
   // Add a callback to the datastore to create a task updater
   // Is this useful? Wouldn't a lambda that gets the subscriber be more useful?
@@ -33,75 +73,112 @@ void WhyconPlugin::init(mc_control::MCGlobalController & controller, const mc_rt
   ctl.datastore().make_call("WhyconPlugin::addTaskUpdater", [this](const std::string & name,
                                                                    const std::string & surface, const std::string & env,
                                                                    const sva::PTransformd & offset) {
-    taskUpdaters_[name] = std::unique_ptr<WhyConUpdater>(new WhyConUpdater(*whyconSubscriber_, surface, env, offset));
+    auto & updater = taskUpdaters_[name];
+    updater.reset(new WhyConUpdater(*whyconSubscriber_, surface, env, offset));
+    for(auto & b : bindings_)
+    { // Tasks bound to a replaced updater follow the new one
+      if(b.name == name)
+      {
+        b.updater = updater.get();
+      }
+    }
   });
   ctl.datastore().make_call("WhyconPlugin::removeTaskUpdater",
-                            [this](const std::string & name) { taskUpdaters_.erase(name); });
+                            [this, &ctl](const std::string & name)
+                            {
+                              unbind(ctl, name);
+                              taskUpdaters_.erase(name);
+                            });
   ctl.datastore().make_call("WhyconPlugin::updateTask", [this](const std::string & name, mc_tasks::MetaTask & task) {
     taskUpdaters_.at(name)->update(task);
   });
   ctl.datastore().make_call(
       "WhyconPlugin::updateLookAtTask",
       [this](const std::string & name, mc_tasks::LookAtTask & task) { taskUpdaters_.at(name)->updateLookAt(task); });
+  // Bound tasks are updated by before() right after the markers estimate, the
+  // task must be unbound (or the updater removed) before it is destroyed. The
+  // result of the last update is available in WhyconPlugin::TaskUpdated::<name>
+  // (WhyconPlugin::LookAtUpdated::<name> for look at tasks).
+  ctl.datastore().make_call("WhyconPlugin::bindTask", [this, &ctl](const std::string & name, mc_tasks::MetaTask & task)
+                            { bind(ctl, name, &task, nullptr); });
+  ctl.datastore().make_call("WhyconPlugin::bindLookAtTask",
+                            [this, &ctl](const std::string & name, mc_tasks::LookAtTask & task)
+                            { bind(ctl, name, nullptr, &task); });
+  ctl.datastore().make_call("WhyconPlugin::unbindTask", [this, &ctl](const std::string & name) { unbind(ctl, name); });
 
   ctl.datastore().make_call("WhyconPlugin::getWhyconSubscriber", [this]() { return whyconSubscriber_; });
 
-  if(!config.has("camera"))
+  addCameras(ctl, *whyconSubscriber_);
+  if(vispSubscriber_)
   {
-    mc_rtc::log::error_and_throw("[WhyconPlugin] No entry named camera in configuration");
+    ctl.datastore().make_call("WhyconPlugin::getVISPSubscriber", [this]() { return vispSubscriber_; });
+    addCameras(ctl, *vispSubscriber_);
   }
 
-  if(!config("camera").has("frame"))
+  initialized_ = true;
+  mc_rtc::log::success("[Plugin::WhyconPlugin] initialized");
+}
+
+void WhyconPlugin::reset(mc_control::MCGlobalController & controller) {}
+
+void WhyconPlugin::bind(mc_control::MCController & ctl,
+                        const std::string & name,
+                        mc_tasks::MetaTask * task,
+                        mc_tasks::LookAtTask * lookAt)
+{
+  auto updater = taskUpdaters_.find(name);
+  if(updater == taskUpdaters_.end())
   {
-    mc_rtc::log::error_and_throw("[WhyconPlugin] No entry camera/frame in configuration");
+    mc_rtc::log::error_and_throw("[WhyconPlugin] No task updater named {}", name);
   }
-  else
+  for(auto & b : bindings_)
   {
-    config("camera")("frame", cameraFrame_);
-    if(!ctl.robot().hasFrame(cameraFrame_))
+    if(b.name == name && (b.lookAt != nullptr) == (lookAt != nullptr))
     {
-      mc_rtc::log::error_and_throw("[WhyconPlugin] No frame named {} for the camera", cameraFrame_);
+      b.task = task;
+      b.lookAt = lookAt;
+      return;
     }
-    cameraOffset_ = config("camera")("offset", sva::PTransformd::Identity());
   }
+  const auto key = std::string(lookAt ? "WhyconPlugin::LookAtUpdated::" : "WhyconPlugin::TaskUpdated::") + name;
+  bindings_.push_back({name, updater->second.get(), task, lookAt, &ctl.datastore().make<bool>(key, false)});
+}
 
-  ctl.gui()->addElement({"Plugins", "WhyCon"},
-                        mc_rtc::gui::ArrayInput(
-                            "Camera offset RPY [deg]", {"x", "y", "z"},
-                            [this]() -> Eigen::Vector3d {
-                              return mc_rbdyn::rpyFromMat(cameraOffset_.rotation()) * 180 / mc_rtc::constants::PI;
-                            },
-                            [this](const Eigen::Vector3d & offset) {
-                              cameraOffset_.rotation() = mc_rbdyn::rpyToMat(offset * mc_rtc::constants::PI / 180);
-                            }),
-                        mc_rtc::gui::ArrayInput(
-                            "Camera offset translation [m]", {"x", "y", "z"},
-                            [this]() -> const Eigen::Vector3d & { return cameraOffset_.translation(); },
-                            [this](const Eigen::Vector3d & offset) { cameraOffset_.translation() = offset; }));
-
-  spinner_ = std::thread([]() {
-    ros::Rate rt(30);
-    while(ros::ok())
-    {
-      ros::spinOnce();
-      rt.sleep();
-    }
-  });
-
-  initialized_ = true;
-  mc_rtc::log::success("[Plugin::WhyconPlugin] initialized");
+void WhyconPlugin::unbind(mc_control::MCController & ctl, const std::string & name)
+{
+  auto it = std::remove_if(bindings_.begin(), bindings_.end(),
+                           [&](const TaskBinding & b)
+                           {
+                             if(b.name != name)
+                             {
+                               return false;
+                             }
+                             ctl.datastore().remove(
+                                 (b.lookAt ? "WhyconPlugin::LookAtUpdated::" : "WhyconPlugin::TaskUpdated::") + name);
+                             return true;
+                           });
+  bindings_.erase(it, bindings_.end());
 }
 
-void WhyconPlugin::reset(mc_control::MCGlobalController & controller) {}
+void WhyconPlugin::updateTasks()
+{
+  for(auto & b : bindings_)
+  {
+    *b.updated = b.lookAt ? b.updater->updateLookAt(*b.lookAt) : b.updater->update(*b.task);
+  }
+}
 
 void WhyconPlugin::before(mc_control::MCGlobalController & controller)
 {
   if(!initialized_) return;
-  // Get Camera position
+  ScopedTimer timer(*beforeTiming_);
   auto & ctl = controller.controller();
-  auto X_0_camera = cameraOffset_ * ctl.realRobot().frame(cameraFrame_).position();
-  whyconSubscriber_->cameraPose(X_0_camera);
-  whyconSubscriber_->tick(controller.controller().timeStep);
+  update(ctl, *whyconSubscriber_);
+  if(vispSubscriber_)
+  {
+    update(ctl, *vispSubscriber_);
+  }
+  updateTasks();
 }
 
 } // namespace whycon_plugin
@@ -10,65 +10,84 @@
 namespace whycon_plugin
 {
 
-sva::PTransformd ApproachVisualServoing::robotMarkerToFrameOffset(const mc_control::fsm::Controller & ctl) const
+void ApproachVisualServoing::MarkerToFrame::reset(const mc_rbdyn::RobotFrame & frame, const MarkerDescriptor & marker)
 {
-  const auto & observer = static_cast<const WhyConSubscriber &>(*subscriber_);
-  const auto & robotMarker = observer.lshape(robotMarkerName_);
-  auto & robot = ctl.robot(robotMarker.robot);
-  auto X_0_robotFrame = robot.frame(robotFrame_).position();
-  auto X_0_robotMarker = robotMarker.frameOffset * robot.frame(robotMarker.frame).position();
-  return X_0_robotFrame * X_0_robotMarker.inv();
+  frame_ = &frame;
+  markerFrame_ = &frame.robot().frame(marker.frame);
+  X_markerFrame_marker_ = marker.frameOffset;
+  rigid_ = frame_->body() == markerFrame_->body();
+  if(rigid_)
+  { // Both positions are relative to the same body
+    X_marker_frame_ = frame_->X_b() * (X_markerFrame_marker_ * markerFrame_->X_b()).inv();
+  }
 }
 
-sva::PTransformd ApproachVisualServoing::targetMarkerToFrameOffset(const mc_control::fsm::Controller & ctl) const
+const sva::PTransformd & ApproachVisualServoing::targetMarkerToFrameOffset()
 {
-  const auto & observer = static_cast<const WhyConSubscriber &>(*subscriber_);
-  const auto & targetMarker = observer.lshape(targetMarkerName_);
-  auto & targetRobot = ctl.robot(targetMarker.robot);
-
-  // Visual servoing target:
-  // First compute the relative transform between the target marker and gripper
-  // marker so that the robot frame is at the target frame (+offset) at the
-  // end of the PBVS task convergence
-  auto X_0_targetMarker = targetMarker.frameOffset * targetRobot.frame(targetMarker.frame).position();
-  auto X_targetMarker_targetFrame_ = targetRobot.frame(targetFrame_).position() * X_0_targetMarker.inv();
-  auto X_targetFrame_target = targetOffset_ * targetFrameOffset_;
-  auto X_targetMarker_target = X_targetFrame_target * X_targetMarker_targetFrame_;
-  return X_targetMarker_target;
+  if(!targetOffsetValid_ || !targetMarkerToFrame_.rigid())
+  {
+    auto X_targetFrame_target = targetOffset_ * targetFrameOffset_;
+    X_targetMarker_target_ = X_targetFrame_target * targetMarkerToFrame_.X_marker_frame();
+    targetOffsetValid_ = true;
+  }
+  return X_targetMarker_target_;
 }
 
-void ApproachVisualServoing::updateLookAt(const mc_control::fsm::Controller & ctl)
+void ApproachVisualServoing::updateLookAt()
 {
   if(!lookAt_)
   {
     return;
   }
-  const auto & observer = static_cast<const WhyConSubscriber &>(*subscriber_);
-  const auto & robotMarker = observer.lshape(robotMarkerName_);
-  const auto & targetMarker = observer.lshape(targetMarkerName_);
-  auto & robot = ctl.robot(robotMarker.robot);
-  auto & targetRobot = ctl.robot(targetMarker.robot);
-  lookAt_->target(sva::interpolate(targetMarker.frameOffset * targetRobot.frame(targetMarker.frame).position(),
-                                   robotMarker.frameOffset * robot.frame(robotMarker.frame).position(), 0.5)
-                      .translation());
+  lookAt_->target(
+      sva::interpolate(targetMarkerToFrame_.X_0_marker(), robotMarkerToFrame_.X_0_marker(), 0.5).translation());
 }
 
 void ApproachVisualServoing::setBoundedSpeed(mc_control::fsm::Controller & ctl, double speed)
 {
-  const auto & robotMarker = subscriber_->lshape(robotMarkerName_);
-  auto & robot = ctl.robot(robotMarker.robot);
-  // XXX (mc_rtc): shouldn't RobotFrame::parent() return a RobotFrame instead of a Frame if the parent was a RobotFrame?
-  const auto & parentFrame = *std::static_pointer_cast<mc_rbdyn::RobotFrame>(robot.frame(robotFrame_).parent());
-
+  if(speed == maxSpeed_ && appliedSpeed_ >= 0)
+  {
+    return;
+  }
   maxSpeed_ = speed;
-  if(constr_)
+  mc_rtc::log::info("[{}] Bounded speed set to {}", name(), maxSpeed_);
+  if(speed == appliedSpeed_)
+  {
+    return;
+  }
+  if(appliedSpeed_ >= 0 && speed > appliedSpeed_ && speedRamp_ > 0)
+  { // Start from the motion allowed by the previous limit
+    ramp_ = std::min(ramp_, appliedSpeed_ / speed);
+    applyStiffness();
+  }
+  const auto & parentFrame = *boundedFrame_;
+  if(appliedSpeed_ >= 0)
   {
     constr_->removeBoundedSpeed(ctl.solver(), parentFrame.name());
   }
-  Eigen::Vector6d spd;
-  spd << M_PI * maxSpeed_, M_PI * maxSpeed_, M_PI * maxSpeed_, maxSpeed_, maxSpeed_, maxSpeed_;
-  constr_->addBoundedSpeed(ctl.solver(), parentFrame, Eigen::MatrixXd::Identity(6, 6), -spd, spd);
-  mc_rtc::log::info("[{}] Bounded speed set to {}", name(), spd.transpose());
+  speedLimit_ << M_PI * speed, M_PI * speed, M_PI * speed, speed, speed, speed;
+  constr_->addBoundedSpeed(ctl.solver(), parentFrame, Eigen::MatrixXd::Identity(6, 6), -speedLimit_, speedLimit_);
+  appliedSpeed_ = speed;
+}
+
+void ApproachVisualServoing::rampStiffness(double dt)
+{
+  if(ramp_ >= 1 || maxSpeed_ <= 0)
+  {
+    return;
+  }
+  ramp_ = std::min(ramp_ + speedRamp_ * dt / maxSpeed_, 1.0);
+  applyStiffness();
+}
+
+void ApproachVisualServoing::applyStiffness()
+{
+  const double stiffness = ramp_ * stiffness_;
+  if(std::abs(stiffness - appliedStiffness_) > 1e-3 * stiffness_)
+  {
+    pbvsTask_->stiffness(stiffness);
+    appliedStiffness_ = stiffness;
+  }
 }
 
 void ApproachVisualServoing::start(mc_control::fsm::Controller & ctl)
@@ -76,6 +95,7 @@ void ApproachVisualServoing::start(mc_control::fsm::Controller & ctl)
   /* Get the selected bracket position from the vision system */
   subscriber_ = ctl.datastore().call<std::shared_ptr<WhyConSubscriber>>("WhyconPlugin::getWhyconSubscriber");
   const auto & observer = static_cast<const WhyConSubscriber &>(*subscriber_);
+  runTiming_ = &subscriber_->instrumentation().stage("ApproachVisualServoing::run");
 
   category_ = config_("category_", std::vector<std::string>{name()});
 
@@ -89,15 +109,30 @@ void ApproachVisualServoing::start(mc_control::fsm::Controller & ctl)
   targetMarkerName_ = static_cast<std::string>(config_("target")("marker"));
   targetFrame_ = static_cast<std::string>(config_("target")("frame"));
   config_("target")("frameOffset", targetFrameOffset_);
+  robotMarker_ = observer.handle(robotMarkerName_);
+  targetMarker_ = observer.handle(targetMarkerName_);
+  robotView_ = observer.view(robotMarker_);
+  targetView_ = observer.view(targetMarker_);
 
-  const auto & targetMarker = observer.lshape(targetMarkerName_);
-  const auto & robotMarker = observer.lshape(robotMarkerName_);
+  const auto & targetMarker = observer.descriptor(targetMarker_);
+  const auto & robotMarker = observer.descriptor(robotMarker_);
   auto & targetRobot = ctl.robot(targetMarker.robot);
   auto & robot = ctl.robot(robotMarker.robot);
+  robotMarkerToFrame_.reset(robot.frame(robotFrame_), robotMarker);
+  targetMarkerToFrame_.reset(targetRobot.frame(targetFrame_), targetMarker);
+  targetOffsetChanged();
+  // XXX (mc_rtc): shouldn't RobotFrame::parent() return a RobotFrame instead of a Frame if the parent was a RobotFrame?
+  boundedFrame_ = std::static_pointer_cast<mc_rbdyn::RobotFrame>(robot.frame(robotFrame_).parent()).get();
 
   /** Create the VS task, will add later */
   pbvsConf("stiffness", stiffness_);
   pbvsConf("maxStiffness", maxStiffness_);
+  GainSchedulerConfig schedulerConfig;
+  if(pbvsConf.has("gainScheduler"))
+  {
+    schedulerConfig.load(pbvsConf("gainScheduler"));
+  }
+  scheduler_ = makeGainScheduler(stiffness_, maxStiffness_, schedulerConfig);
   pbvsTask_ = std::make_shared<mc_tasks::PositionBasedVisServoTask>(
       robot.frame(robotFrame_), sva::PTransformd::Identity(), /* No initial error, will be set by the updater later */
       stiffness_, pbvsConf("weight", 500.));
@@ -110,27 +145,35 @@ void ApproachVisualServoing::start(mc_control::fsm::Controller & ctl)
   pbvsConf("use", useVisualServoing_);
   pbvsConf("eval", evalTh_);
   pbvsConf("speed", speedTh_);
+  pbvsConf("feedForward", feedForward_);
+  if(feedForward_ && observer.filter(targetMarker_).config().type == MarkerFilterConfig::Type::None)
+  {
+    mc_rtc::log::warning("[{}] No filter on marker {}, its velocity is not estimated and will not be fed forward",
+                         name(), targetMarkerName_);
+  }
 
   constr_ = std::make_shared<mc_solver::BoundedSpeedConstr>(ctl.robots(), robot.robotIndex(), ctl.solver().dt());
   ctl.solver().addConstraintSet(*constr_);
   pbvsConf("maxSpeed", maxSpeedDesired_);
+  pbvsConf("speedRamp", speedRamp_);
+  pbvsConf("visibilityDebounce", visibilityDebounce_);
   maxSpeed_ = maxSpeedDesired_;
-
-  auto targetOffset = targetMarkerToFrameOffset(ctl);
-  auto robotOffset = robotMarkerToFrameOffset(ctl);
+  appliedSpeed_ = -1;
+  ramp_ = 1;
+  appliedStiffness_ = stiffness_;
 
   /* approach */
   bool useMarker = approachConf("useMarker", false);
   auto approachOffset = approachConf("offset", sva::PTransformd::Identity());
-  auto X_0_markerFrame = targetRobot.frame(targetMarker.frame).position();
-  auto X_0_targetFrame_ = targetRobot.frame(targetFrame_).position();
+  auto X_0_markerFrame = targetMarkerToFrame_.markerFrame().position();
+  auto X_0_targetFrame_ = targetMarkerToFrame_.X_0_frame();
   auto X_markerFrame_targetFrame_ = X_0_targetFrame_ * X_0_markerFrame.inv();
   mc_tasks::BSplineTrajectoryTask::waypoints_t waypoints;
   std::vector<std::pair<double, Eigen::Matrix3d>> oriWp;
   if(useMarker)
   { /* Target relative to the target marker */
     X_0_bracket_ =
-        approachOffset * targetFrameOffset_ * X_markerFrame_targetFrame_ * observer.X_0_marker(targetMarkerName_);
+        approachOffset * targetFrameOffset_ * X_markerFrame_targetFrame_ * observer.X_0_marker(targetMarker_);
   }
   else
   { /* Target relative to the target robot's frame */
@@ -213,7 +256,8 @@ void ApproachVisualServoing::pause(mc_control::fsm::Controller & ctl)
 {
   if(vsPaused_) return;
   vsPaused_ = true;
-  pbvsTask_->error(sva::PTransformd::Identity());
+  setError(sva::PTransformd::Identity());
+  clearFeedForward();
   setBoundedSpeed(ctl, 0);
 }
 
@@ -238,10 +282,65 @@ void ApproachVisualServoing::enableVisualServoing(mc_control::fsm::Controller &
   ctl.gui()->removeElement(category_, "Enable visual servoing");
 }
 
+void ApproachVisualServoing::setError(const sva::PTransformd & X_t_s)
+{
+  pbvsTask_->error(X_t_s);
+  error_ = X_t_s.translation().norm();
+}
+
+void ApproachVisualServoing::updateFeedForward()
+{
+  if(!feedForward_)
+  {
+    return;
+  }
+  // The PBVS task error is [thetau, t] of X_t_s and its speed is the rate of
+  // this error caused by the motion of the robot frame alone (the task assumes
+  // a static target), refVel is compared against that speed. When the target
+  // moves the error drifts by de_target, the frame must produce -de_target to
+  // keep the error constant: differentiate the error numerically over a small
+  // displacement of the target marker so that the sign and the interaction
+  // matrix are exactly those of the task
+  const auto & estimate = subscriber_->estimate(targetMarker_);
+  const auto & v = estimate.velocity;
+  const Eigen::Matrix3d & E_0_marker = estimate.pose.rotation();
+  const Eigen::Vector3d w = E_0_marker * v.angular();
+  const double angle = w.norm() * FeedForwardStep;
+  Eigen::Matrix3d E = Eigen::Matrix3d::Identity();
+  if(angle > 1e-12)
+  {
+    E = Eigen::AngleAxisd(angle, w.normalized()).toRotationMatrix().transpose();
+  }
+  // Displacement of the marker expressed in the marker frame
+  const sva::PTransformd X_marker_next(E, E_0_marker * v.linear() * FeedForwardStep);
+  const auto & envOffset = targetMarkerToFrameOffset();
+  const auto X_camera_target = envOffset * X_marker_next * envOffset.inv() * X_camera_target_;
+  const auto X_t_s = X_camera_frame_ * X_camera_target.inv();
+  refVel_ = (pbvsError(X_t_s_) - pbvsError(X_t_s)) / FeedForwardStep;
+  pbvsTask_->refVel(refVel_);
+}
+
+Eigen::Vector6d ApproachVisualServoing::pbvsError(const sva::PTransformd & X_t_s)
+{
+  Eigen::Vector6d err;
+  const Eigen::AngleAxisd aa(X_t_s.rotation());
+  err.head<3>() = aa.angle() * aa.axis();
+  err.tail<3>() = X_t_s.translation();
+  return err;
+}
+
+void ApproachVisualServoing::clearFeedForward()
+{
+  refVel_.setZero();
+  pbvsTask_->refVel(refVel_);
+}
+
 bool ApproachVisualServoing::updatePBVSTask(mc_control::fsm::Controller & ctl)
 {
-  auto & task = pbvsTask_;
-  visible_ = subscriber_->visible(targetMarkerName_) && subscriber_->visible(robotMarkerName_);
+  // Both markers must be seen by the same camera, their positions in two
+  // different cameras cannot be combined
+  const auto camera = subscriber_->commonCamera(robotMarker_, targetMarker_);
+  visible_ = camera != WhyConSubscriber::npos;
 
   // If the marker becomes not visible, disable task
   if(!visible_)
@@ -250,10 +349,18 @@ bool ApproachVisualServoing::updatePBVSTask(mc_control::fsm::Controller & ctl)
     {
       mc_rtc::log::warning("[{}] Disabling visual servoing updates, will re-enable when the markers become visible",
                            name());
-      pbvsTask_->error(sva::PTransformd::Identity());
-      setBoundedSpeed(ctl, 0);
+      setError(sva::PTransformd::Identity());
+      clearFeedForward();
       wasVisible_ = false;
+      hiddenFor_ = 0;
     }
+    // Only stop the robot if the markers are lost for a while, flickering
+    // visibility would otherwise resize the QP on every change
+    if(hiddenFor_ >= visibilityDebounce_)
+    {
+      setBoundedSpeed(ctl, 0);
+    }
+    hiddenFor_ += ctl.timeStep;
     return false;
   }
 
@@ -264,12 +371,28 @@ bool ApproachVisualServoing::updatePBVSTask(mc_control::fsm::Controller & ctl)
     setBoundedSpeed(ctl, maxSpeedDesired_);
   }
 
+  // The error only changes with the samples (or the offsets when they depend on
+  // the robot configuration or the GUI), keep it between two frames
+  if(wasVisible_ && camera == camera_ && !subscriber_->hasNewSample(robotMarker_, robotSeq_)
+     && !subscriber_->hasNewSample(targetMarker_, targetSeq_) && targetOffsetValid_ && robotMarkerToFrame_.rigid()
+     && targetMarkerToFrame_.rigid())
+  {
+    updateFeedForward();
+    return true;
+  }
+  robotSeq_ = robotView_.seq();
+  targetSeq_ = targetView_.seq();
+  camera_ = camera;
+
   static bool once = true;
-  auto envOffset = targetMarkerToFrameOffset(ctl);
-  auto frameOffset = robotMarkerToFrameOffset(ctl);
-  auto X_camera_target = envOffset * subscriber_->X_camera_marker(targetMarkerName_);
-  auto X_camera_frame = frameOffset * subscriber_->X_camera_marker(robotMarkerName_);
+  const auto & envOffset = targetMarkerToFrameOffset();
+  auto frameOffset = robotMarkerToFrameOffset();
+  auto X_camera_target = envOffset * subscriber_->X_camera_marker(targetMarker_, camera);
+  auto X_camera_frame = frameOffset * subscriber_->X_camera_marker(robotMarker_, camera);
   auto X_t_s = X_camera_frame * X_camera_target.inv();
+  X_camera_target_ = X_camera_target;
+  X_camera_frame_ = X_camera_frame;
+  X_t_s_ = X_t_s;
   if(once)
   {
     std::cout << "X_camera_target:\n"
@@ -294,18 +417,21 @@ bool ApproachVisualServoing::updatePBVSTask(mc_control::fsm::Controller & ctl)
               << "\n";
     once = false;
   }
-  task->error(X_t_s);
+  setError(X_t_s);
+  updateFeedForward();
   wasVisible_ = visible_;
   return true;
 }
 
 bool ApproachVisualServoing::run(mc_control::fsm::Controller & ctl)
 {
+  ScopedTimer timer(*runTiming_);
   if(!task_)
   {
     output("NoVision");
     return true;
   }
+  rampStiffness(ctl.timeStep);
 
   /* Approach trajectory completed, start visual servoing */
   if(!posDone_)
@@ -320,7 +446,7 @@ bool ApproachVisualServoing::run(mc_control::fsm::Controller & ctl)
       {
         ctl.solver().addTask(lookAt_);
         mc_rtc::log::info("[{}] completed, update lookat", name());
-        updateLookAt(ctl);
+        updateLookAt();
       }
       if(useVisualServoing_)
       {
@@ -357,25 +483,30 @@ bool ApproachVisualServoing::run(mc_control::fsm::Controller & ctl)
                                  return "unknown";
                                }),
             mc_rtc::gui::Label("Marker " + robotMarkerName_,
-                               [this]() { return subscriber_->visible(robotMarkerName_) ? "visible" : "not visible"; }),
+                               [this]() { return robotView_.visible() ? "visible" : "not visible"; }),
             mc_rtc::gui::Label("Marker " + targetMarkerName_, [this]()
-                               { return subscriber_->visible(targetMarkerName_) ? "visible" : "not visible"; }),
-            mc_rtc::gui::Label("Error [m]",
-                               [this]()
-                               {
-                                 if(pbvsTask_)
-                                 {
-                                   return pbvsTask_->eval().tail(3).norm();
-                                 }
-                                 return 0.;
-                               }),
+                               { return targetView_.visible() ? "visible" : "not visible"; }),
+            mc_rtc::gui::Label("Error [m]", [this]() { return error_; }),
             mc_rtc::gui::Button("Pause", [this, &ctl]() { pause(ctl); }),
             mc_rtc::gui::Button("Resume", [this, &ctl]() { resume(ctl); }),
             mc_rtc::gui::Label("Stiffness", [this]() { return stiffness_; }),
             mc_rtc::gui::NumberInput(
                 "Max stiffness", [this]() { return maxStiffness_; },
-                [this](double s) { maxStiffness_ = std::max(0., s); }),
-            mc_rtc::gui::Label("Actual max speed", [this]() { return maxSpeed_; }),
+                [this](double s)
+                {
+                  maxStiffness_ = std::max(0., s);
+                  scheduler_->maxStiffness(maxStiffness_);
+                }),
+            mc_rtc::gui::Checkbox("Velocity feed-forward", [this]() { return feedForward_; },
+                                  [this]()
+                                  {
+                                    feedForward_ = !feedForward_;
+                                    if(!feedForward_)
+                                    {
+                                      clearFeedForward();
+                                    }
+                                  }),
+            mc_rtc::gui::Label("Actual max speed", [this]() { return std::max(appliedSpeed_, 0.); }),
             mc_rtc::gui::NumberInput(
                 "Max speed", [this]() { return maxSpeedDesired_; },
                 [this, &ctl](double s)
@@ -389,13 +520,20 @@ bool ApproachVisualServoing::run(mc_control::fsm::Controller & ctl)
             mc_rtc::gui::ArrayInput(
                 "Offset wrt target frame (translation) [m]", {"x", "y", "z"},
                 [this]() -> const Eigen::Vector3d & { return targetOffset_.translation(); },
-                [this](const Eigen::Vector3d & t) { targetOffset_.translation() = t; }),
+                [this](const Eigen::Vector3d & t)
+                {
+                  targetOffset_.translation() = t;
+                  targetOffsetChanged();
+                }),
             mc_rtc::gui::ArrayInput(
                 "Offset wrt target frame (rotation) [deg]", {"r", "p", "y"},
                 [this]() -> Eigen::Vector3d
                 { return mc_rbdyn::rpyFromMat(targetOffset_.rotation()) * 180. / mc_rtc::constants::PI; },
                 [this](const Eigen::Vector3d & rpy)
-                { targetOffset_.rotation() = mc_rbdyn::rpyToMat(rpy * mc_rtc::constants::PI / 180.); }));
+                {
+                  targetOffset_.rotation() = mc_rbdyn::rpyToMat(rpy * mc_rtc::constants::PI / 180.);
+                  targetOffsetChanged();
+                }));
       }
     }
   }
@@ -405,9 +543,8 @@ bool ApproachVisualServoing::run(mc_control::fsm::Controller & ctl)
   }
   else if(useVisualServoing_ && !vsDone_)
   {
-    updateLookAt(ctl);
-    if(visible_ && pbvsTask_->eval().tail(3).norm() < evalTh_ && pbvsTask_->speed().tail(3).norm() < speedTh_
-       && iter_++ > 10)
+    updateLookAt();
+    if(visible_ && error_ < evalTh_ && frameSpeed() < speedTh_ && iter_++ > 10)
     {
       vsDone_ = true;
       task_->reset();
@@ -421,16 +558,19 @@ bool ApproachVisualServoing::run(mc_control::fsm::Controller & ctl)
     else
     {
       updatePBVSTask(ctl);
-      // If we still haven't converged, double stiffness every 100 iterations
-      if(pbvsTask_->speed().tail(3).norm() < speedTh_ && iter_++ > 100)
+      // If we still haven't converged, let the scheduler adjust the stiffness
+      GainSchedulerInput input;
+      input.error = error_;
+      input.speed = frameSpeed();
+      input.speedThreshold = speedTh_;
+      input.maxSpeed = std::max(appliedSpeed_, 0.);
+      input.age = std::max(robotView_.lastUpdate(), targetView_.lastUpdate());
+      input.dt = ctl.timeStep;
+      const double stiffness = scheduler_->update(input);
+      if(std::abs(stiffness - stiffness_) > 1e-3 * stiffness_)
       {
-        double stiffness = std::min(2 * stiffness_, maxStiffness_);
-        if(pbvsTask_->stiffness() < stiffness)
-        {
-          pbvsTask_->stiffness(stiffness);
-          iter_ = 0;
-          stiffness_ = stiffness;
-        }
+        stiffness_ = stiffness;
+        applyStiffness();
       }
     }
   }
@@ -2,6 +2,7 @@
 
 #include <mc_control/CompletionCriteria.h>
 #include <mc_control/fsm/Controller.h>
+#include <mc_whycon_plugin/GainScheduler.h>
 #include <mc_whycon_plugin/TaskUpdater.h>
 
 #include <mc_solver/BoundedSpeedConstr.h>
@@ -26,20 +27,121 @@ struct ApproachVisualServoing : mc_control::fsm::State
   void teardown(mc_control::fsm::Controller & ctl) override;
 
 private:
-  sva::PTransformd robotMarkerToFrameOffset(const mc_control::fsm::Controller & ctl) const;
+  /** Transform from a marker to a frame of the robot carrying it
+   *
+   * The frames are resolved once. The transform is cached if both frames are
+   * attached to the same body, otherwise it depends on the robot
+   * configuration and is computed from the frame positions.
+   */
+  struct MarkerToFrame
+  {
+    void reset(const mc_rbdyn::RobotFrame & frame, const MarkerDescriptor & marker);
+
+    /** Position of the frame */
+    inline sva::PTransformd X_0_frame() const
+    {
+      return frame_->position();
+    }
+
+    /** Position of the marker according to the robot model */
+    inline sva::PTransformd X_0_marker() const
+    {
+      return X_markerFrame_marker_ * markerFrame_->position();
+    }
+
+    inline sva::PTransformd X_marker_frame() const
+    {
+      return rigid_ ? X_marker_frame_ : X_0_frame() * X_0_marker().inv();
+    }
+
+    /** True if the transform does not depend on the robot configuration */
+    inline bool rigid() const noexcept
+    {
+      return rigid_;
+    }
+
+    /** Frame controlled relative to the marker */
+    inline const mc_rbdyn::RobotFrame & frame() const noexcept
+    {
+      return *frame_;
+    }
+
+    /** Frame the marker is attached to */
+    inline const mc_rbdyn::RobotFrame & markerFrame() const noexcept
+    {
+      return *markerFrame_;
+    }
+
+  private:
+    const mc_rbdyn::RobotFrame * frame_ = nullptr;
+    const mc_rbdyn::RobotFrame * markerFrame_ = nullptr;
+    sva::PTransformd X_markerFrame_marker_ = sva::PTransformd::Identity();
+    bool rigid_ = false;
+    sva::PTransformd X_marker_frame_ = sva::PTransformd::Identity();
+  };
+
+  inline sva::PTransformd robotMarkerToFrameOffset() const
+  {
+    return robotMarkerToFrame_.X_marker_frame();
+  }
 
   // Visual servoing target:
   // First compute the relative transform between the target marker and gripper
   // marker so that the robot frame is at the target frame (+offset) at the
   // end of the PBVS task convergence
-  sva::PTransformd targetMarkerToFrameOffset(const mc_control::fsm::Controller & ctl) const;
+  const sva::PTransformd & targetMarkerToFrameOffset();
+
+  /** Invalidate the cached target offset, to be called when targetOffset_ changes */
+  inline void targetOffsetChanged() noexcept
+  {
+    targetOffsetValid_ = false;
+  }
 
   bool updatePBVSTask(mc_control::fsm::Controller & ctl);
 
+  /** Set the error of the PBVS task and keep its translation norm */
+  void setError(const sva::PTransformd & X_t_s);
+
+  /** Set the reference velocity of the PBVS task from the estimated velocity
+   * of the target marker (if feedForward_ is enabled) */
+  void updateFeedForward();
+
+  /** Reset the reference velocity of the PBVS task */
+  void clearFeedForward();
+
+  /** Error vector of the PBVS task for the given X_t_s (thetau, translation) */
+  static Eigen::Vector6d pbvsError(const sva::PTransformd & X_t_s);
+
+  /** Time step used to differentiate the PBVS error [s] */
+  static constexpr double FeedForwardStep = 1e-3;
+
+  /** Linear speed of the robot frame [m/s]
+   *
+   * Same norm as the translation part of the PBVS task speed, without
+   * copying the task speed vector */
+  inline double frameSpeed() const
+  {
+    return robotMarkerToFrame_.frame().velocity().linear().norm();
+  }
+
   /** Look halfway between the expected marker pose and the marker pose on the
    * robot */
-  void updateLookAt(const mc_control::fsm::Controller & ctl);
+  void updateLookAt();
+  /** Set the speed limit of the robot frame
+   *
+   * mc_solver::BoundedSpeedConstr cannot modify an existing limit: the entry
+   * is removed then added again, which resizes the QP. A change of limit costs
+   * exactly one such rebuild and none if the limit does not change. When the
+   * limit is raised the motion is smoothed on the task side instead, see
+   * rampStiffness().
+   */
   void setBoundedSpeed(mc_control::fsm::Controller & ctl, double speed);
+  /** Scale the PBVS stiffness from the ratio of the previous and new speed
+   * limits up to 1 after the limit was raised, called every iteration. This
+   * never modifies the constraint. */
+  void rampStiffness(double dt);
+  /** Set the stiffness of the PBVS task to ramp_ * stiffness_ if it changed */
+  void applyStiffness();
   void pause(mc_control::fsm::Controller & ctl);
   void resume(mc_control::fsm::Controller & ctl);
   void enableVisualServoing(mc_control::fsm::Controller & ctl);
@@ -52,12 +154,33 @@ private:
   sva::PTransformd targetFrameOffset_ = sva::PTransformd::Identity();
   std::string robotMarkerName_;
   std::string targetMarkerName_;
+  /** Handles of the markers, resolved in start() */
+  MarkerHandle robotMarker_;
+  MarkerHandle targetMarker_;
+  /** Views of the markers, resolved in start() */
+  MarkerView robotView_;
+  MarkerView targetView_;
+  /** Frames of the markers, resolved in start() */
+  MarkerToFrame robotMarkerToFrame_;
+  MarkerToFrame targetMarkerToFrame_;
+  /** Parent of the robot frame, whose speed is bounded */
+  const mc_rbdyn::RobotFrame * boundedFrame_ = nullptr;
+  /** Sequence numbers of the samples used to compute the PBVS error */
+  uint64_t robotSeq_ = 0;
+  uint64_t targetSeq_ = 0;
+  /** Camera seeing both markers, the PBVS error is computed in this camera */
+  size_t camera_ = WhyConSubscriber::npos;
+  /** Cached result of targetMarkerToFrameOffset() */
+  sva::PTransformd X_targetMarker_target_ = sva::PTransformd::Identity();
+  bool targetOffsetValid_ = false;
 
   /* Offset relative to the target frame where the
    * visual servoing task is to drive the robot */
   sva::PTransformd targetOffset_ = sva::PTransformd::Identity();
 
   std::shared_ptr<WhyConSubscriber> subscriber_ = nullptr;
+  /** Duration of run() */
+  LatencyHistogram * runTiming_ = nullptr;
 
   /** Spline task used to drive the gripper above
    * XXX: to be repaced with a spline with exact waypoints in the future
@@ -77,18 +200,45 @@ private:
   std::shared_ptr<mc_solver::BoundedSpeedConstr> constr_;
   /* stiffness of the visual servoing task
    * Note that in case of non-convergence this stiffness will gradually increase
-   * until convergence up to maxStiffness_
+   * until convergence up to maxStiffness_, see scheduler_
    **/
   double stiffness_ = 2;
   double maxStiffness_ = 2;
-  /** actual max speed */
+  /** Chooses the stiffness of the visual servoing task (visualServoing/gainScheduler) */
+  std::unique_ptr<GainScheduler> scheduler_;
+  /** Speed limit requested by setBoundedSpeed() */
   double maxSpeed_ = 0.01;
   /* desired max speed */
   double maxSpeedDesired_ = 0.01;
+  /** Limit of the bounded speed constraint in the solver, negative if there is none */
+  double appliedSpeed_ = -1;
+  /** Rate at which the motion reaches a raised speed limit, 0 to disable [m/s^2] */
+  double speedRamp_ = 0.05;
+  /** Fraction of stiffness_ applied to the PBVS task, in [0, 1] */
+  double ramp_ = 1;
+  /** Stiffness of the PBVS task */
+  double appliedStiffness_ = 0;
+  /** Limits passed to the constraint (angular, linear) */
+  Eigen::VectorXd speedLimit_ = Eigen::VectorXd::Zero(6);
+  /** Time the markers must be lost before the robot is stopped [s] */
+  double visibilityDebounce_ = 0.1;
+  /** Time since the markers were lost [s] */
+  double hiddenFor_ = 0;
   /** Whether visual servoing needs to be manually triggered */
   bool manualConfirmation_ = true;
   /** Evaluation threshold for the task */
   double evalTh_ = 0.02;
+  /** Norm of the translation error of the PBVS task [m] */
+  double error_ = 0;
+  /** Feed the estimated velocity of the target marker forward to the PBVS
+   * task, requires a filter on the target marker (see MarkerFilter) */
+  bool feedForward_ = false;
+  /** Reference velocity of the PBVS task, rate of the task error (see pbvsError) */
+  Eigen::VectorXd refVel_ = Eigen::VectorXd::Zero(6);
+  /** Poses used to compute the last PBVS error */
+  sva::PTransformd X_camera_target_ = sva::PTransformd::Identity();
+  sva::PTransformd X_camera_frame_ = sva::PTransformd::Identity();
+  sva::PTransformd X_t_s_ = sva::PTransformd::Identity();
   /** Speed threshold for the task */
   double speedTh_ = 0.02;
 